@@ -1,6 +1,8 @@
 #ifndef BETANN_BUFFER_H_
 #define BETANN_BUFFER_H_
 
+#include <memory>
+
 #include <webgpu/webgpu_cpp.h>
 
 namespace betann {
@@ -11,6 +13,8 @@ struct Buffer {
   wgpu::Buffer data;
   uint64_t size = WGPU_WHOLE_SIZE;
   uint64_t offset = 0;
+  // Memory accounting of the buffer, released when all copies are destroyed.
+  std::shared_ptr<void> allocation;
 
   Buffer() {}
   Buffer(std::nullptr_t) {}
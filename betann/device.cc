@@ -1,36 +1,183 @@
 #include "betann/device.h"
 
 #include <array>
+#include <mutex>
 #include <stdexcept>
 
+#include <dawn/native/DawnNative.h>
 #include <fmt/format.h>
 
 namespace betann {
 
-Device::Device() {
-  // Create instance.
+namespace {
+
+wgpu::InstanceDescriptor GetInstanceDescriptor() {
   wgpu::InstanceDescriptor instanceDescriptor;
   instanceDescriptor.capabilities.timedWaitAnyEnable = true;
-  instance_ = wgpu::CreateInstance(&instanceDescriptor);
-  if (!instance_)
-    throw std::runtime_error("CreateInstance failed.");
+  return instanceDescriptor;
+}
+
+}  // namespace
+
+class MemoryTracker : public std::enable_shared_from_this<MemoryTracker> {
+ public:
+  // Account |size| bytes in |category|, the returned token releases them when
+  // destroyed.
+  std::shared_ptr<void> Allocate(MemoryCategory category, uint64_t size) {
+    Device::SoftMemoryBudgetCallback cb;
+    uint64_t current;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (budget_ > 0 && total_.current + size > budget_) {
+        throw std::runtime_error(fmt::format(
+            "Can not allocate {} bytes with {} of {} bytes memory budget used.",
+            size, total_.current, budget_));
+      }
+      bool underSoftBudget = total_.current <= softBudget_;
+      for (MemoryUsage* usage : {&total_, &Get(category)}) {
+        usage->current += size;
+        usage->peak = std::max(usage->peak, usage->current);
+      }
+      current = total_.current;
+      if (softBudget_ > 0 && underSoftBudget && current > softBudget_)
+        cb = softBudgetCallback_;
+    }
+    if (cb)
+      cb(current);
+    return std::shared_ptr<void>(
+        nullptr,
+        [self = shared_from_this(), category, size](void*) {
+          std::lock_guard<std::mutex> lock(self->mutex_);
+          self->total_.current -= size;
+          self->Get(category).current -= size;
+        });
+  }
+
+  MemoryUsage GetUsage() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_;
+  }
+
+  MemoryUsage GetUsage(MemoryCategory category) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Get(category);
+  }
 
-  // Synchronously request the adapter.
+  void ResetPeak() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    total_.peak = total_.current;
+    for (MemoryUsage& usage : categories_)
+      usage.peak = usage.current;
+  }
+
+  void SetBudget(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = bytes;
+  }
+
+  void SetSoftBudget(uint64_t bytes, Device::SoftMemoryBudgetCallback cb) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    softBudget_ = bytes;
+    softBudgetCallback_ = std::move(cb);
+  }
+
+ private:
+  MemoryUsage& Get(MemoryCategory category) {
+    return categories_[static_cast<size_t>(category)];
+  }
+
+  std::mutex mutex_;
+  MemoryUsage total_;
+  std::array<MemoryUsage, 4> categories_;
+  uint64_t budget_ = 0;
+  uint64_t softBudget_ = 0;
+  Device::SoftMemoryBudgetCallback softBudgetCallback_;
+};
+
+std::vector<wgpu::Adapter> EnumerateAdapters() {
+  wgpu::InstanceDescriptor instanceDescriptor = GetInstanceDescriptor();
+  dawn::native::Instance instance(
+      reinterpret_cast<const WGPUInstanceDescriptor*>(&instanceDescriptor));
   wgpu::RequestAdapterOptions options;
-  options.powerPreference = wgpu::PowerPreference::HighPerformance;
-  wgpu::Future future = instance_.RequestAdapter(
-      &options,
-      wgpu::CallbackMode::WaitAnyOnly,
-      [this](wgpu::RequestAdapterStatus status,
-             wgpu::Adapter result,
-             const char* message) {
-        if (status != wgpu::RequestAdapterStatus::Success) {
-          throw std::runtime_error(
-              fmt::format("RequestAdapter failed: {}", message));
-        }
-        adapter_ = std::move(result);
-      });
-  instance_.WaitAny(future, 5 * 1000);
+  std::vector<wgpu::Adapter> adapters;
+  for (const dawn::native::Adapter& native :
+       instance.EnumerateAdapters(&options)) {
+    // The adapters hold a reference to the instance.
+    wgpu::Adapter adapter(native.Get());
+    wgpu::AdapterInfo info;
+    if (adapter.GetInfo(&info) != wgpu::Status::Success ||
+        info.backendType == wgpu::BackendType::Null) {
+      continue;
+    }
+    adapters.push_back(std::move(adapter));
+  }
+  return adapters;
+}
+
+CommandGraph::CommandGraph() = default;
+
+CommandGraph::~CommandGraph() = default;
+
+CommandGraph::CommandGraph(CommandGraph&&) = default;
+
+CommandGraph& CommandGraph::operator=(CommandGraph&&) = default;
+
+void CommandGraph::DeclareBindings(std::vector<Buffer> bindings) {
+  bindingUses_.assign(bindings.size(), {});
+  for (size_t i = 0; i < bindings.size(); ++i) {
+    for (size_t c = 0; c < commands_.size(); ++c) {
+      const std::vector<Buffer>& buffers = commands_[c].buffers;
+      for (size_t b = 0; b < buffers.size(); ++b) {
+        if (buffers[b].data.Get() == bindings[i].data.Get())
+          bindingUses_[i].emplace_back(c, b);
+      }
+    }
+  }
+  bindings_ = std::move(bindings);
+}
+
+Device::Device() : Device(nullptr) {}
+
+Device::MemoryScope::MemoryScope(Device& device, MemoryCategory category)
+    : device_(device), previous_(device.memoryCategory_) {
+  device_.memoryCategory_ = category;
+}
+
+Device::MemoryScope::~MemoryScope() {
+  device_.memoryCategory_ = previous_;
+}
+
+Device::Device(wgpu::Adapter adapter)
+    : adapter_(std::move(adapter)),
+      memory_(std::make_shared<MemoryTracker>()) {
+  wgpu::Future future;
+  if (adapter_) {
+    // Use the instance that created the adapter.
+    instance_ = adapter_.GetInstance();
+  } else {
+    // Create instance.
+    wgpu::InstanceDescriptor instanceDescriptor = GetInstanceDescriptor();
+    instance_ = wgpu::CreateInstance(&instanceDescriptor);
+    if (!instance_)
+      throw std::runtime_error("CreateInstance failed.");
+
+    // Synchronously request the adapter.
+    wgpu::RequestAdapterOptions options;
+    options.powerPreference = wgpu::PowerPreference::HighPerformance;
+    future = instance_.RequestAdapter(
+        &options,
+        wgpu::CallbackMode::WaitAnyOnly,
+        [this](wgpu::RequestAdapterStatus status,
+               wgpu::Adapter result,
+               const char* message) {
+          if (status != wgpu::RequestAdapterStatus::Success) {
+            throw std::runtime_error(
+                fmt::format("RequestAdapter failed: {}", message));
+          }
+          adapter_ = std::move(result);
+        });
+    instance_.WaitAny(future, 5 * 1000);
+  }
   // Check if there is a valid backend.
   if (adapter_.GetInfo(&adapterInfo_) != wgpu::Status::Success)
     throw std::runtime_error("GetInfo failed.");
@@ -132,6 +279,15 @@ void Device::Flush() {
   } else {
     queue_.Submit(commands_.size(), commands_.data());
     commands_.clear();
+    // Keep the memory of buffers used by the submitted commands accounted
+    // until the GPU has finished with them.
+    if (!pendingAllocations_.empty()) {
+      AddFuture(queue_.OnSubmittedWorkDone(
+          wgpu::CallbackMode::AllowProcessEvents,
+          [allocations = std::move(pendingAllocations_)](
+              wgpu::QueueWorkDoneStatus status) {}));
+      pendingAllocations_.clear();
+    }
   }
 }
 
@@ -165,7 +321,10 @@ Buffer Device::CreateBuffer(uint64_t size,
   descriptor.usage = usage;
   descriptor.size = size;
   descriptor.mappedAtCreation = mappedAtCreation;
-  return {device_.CreateBuffer(&descriptor)};
+  std::shared_ptr<void> allocation = memory_->Allocate(memoryCategory_, size);
+  Buffer buffer(device_.CreateBuffer(&descriptor));
+  buffer.allocation = std::move(allocation);
+  return buffer;
 }
 
 Buffer Device::CreateBufferFromData(const void* data,
@@ -177,11 +336,20 @@ Buffer Device::CreateBufferFromData(const void* data,
   return buffer;
 }
 
+Buffer Device::CreateParametersBuffer(const void* data,
+                                      uint64_t size,
+                                      BufferUsage usage) {
+  MemoryScope memoryScope(*this, MemoryCategory::Parameters);
+  return CreateBufferFromData(data, size, usage);
+}
+
 void Device::WriteBuffer(void* data, uint64_t size, Buffer& buffer) {
   queue_.WriteBuffer(buffer.data, buffer.offset, data, size);
 }
 
 wgpu::Future Device::ReadBuffer(const Buffer& buffer, ReadBufferCallback cb) {
+  if (capture_)
+    throw std::runtime_error("Can not read buffer while capturing commands.");
   // Merge simultaneous read.
   WGPUBuffer key = buffer.data.Get();
   auto it = pendingReadBuffers_.find(key);
@@ -250,11 +418,11 @@ wgpu::BindGroup Device::CreateBindGroup(const wgpu::ComputePipeline& kernel,
                                         std::vector<Buffer> buffers) {
   std::vector<wgpu::BindGroupEntry> entries;
   uint32_t index = 0;
-  for (Buffer& buffer : buffers) {
+  for (const Buffer& buffer : buffers) {
     if (buffer.data) {
       wgpu::BindGroupEntry entry;
       entry.binding = index++;
-      entry.buffer = std::move(buffer.data);
+      entry.buffer = buffer.data;
       entry.size = buffer.size;
       entry.offset = buffer.offset;
       entries.push_back(std::move(entry));
@@ -264,12 +432,36 @@ wgpu::BindGroup Device::CreateBindGroup(const wgpu::ComputePipeline& kernel,
   descriptor.layout = kernel.GetBindGroupLayout(0);
   descriptor.entryCount = entries.size();
   descriptor.entries = entries.data();
-  return device_.CreateBindGroup(&descriptor);
+  wgpu::BindGroup bindGroup = device_.CreateBindGroup(&descriptor);
+  if (!capture_) {
+    for (const Buffer& buffer : buffers)
+      KeepAllocation(buffer);
+  } else {
+    // Remember the buffers so they can be replaced when replaying, which also
+    // keeps their memory accounted while the graph is alive.
+    std::vector<Buffer>& captured = capturedBindGroups_[bindGroup.Get()];
+    for (Buffer& buffer : buffers) {
+      if (buffer.data)
+        captured.push_back(std::move(buffer));
+    }
+  }
+  return bindGroup;
 }
 
 void Device::RunKernel(const wgpu::ComputePipeline& kernel,
                        const wgpu::BindGroup& bindGroup,
                        Dims3 workgroupsCount) {
+  if (capture_) {
+    CommandGraph::Command command;
+    command.kernel = kernel;
+    command.bindGroup = bindGroup;
+    command.workgroupsCount = workgroupsCount;
+    auto it = capturedBindGroups_.find(bindGroup.Get());
+    if (it != capturedBindGroups_.end())
+      command.buffers = it->second;
+    capture_->commands_.push_back(std::move(command));
+    return;
+  }
   EnsureEncoder();
   wgpu::ComputePassEncoder pass = encoder_.BeginComputePass();
   pass.SetPipeline(kernel);
@@ -280,6 +472,127 @@ void Device::RunKernel(const wgpu::ComputePipeline& kernel,
   pass.End();
 }
 
+void Device::CopyBufferToBuffer(const Buffer& src,
+                                uint64_t srcOffset,
+                                const Buffer& dst,
+                                uint64_t dstOffset,
+                                uint64_t size) {
+  if (capture_) {
+    CommandGraph::Command command;
+    command.buffers = {src, dst};
+    command.buffers[0].offset = srcOffset;
+    command.buffers[1].offset = dstOffset;
+    command.copySize = size;
+    capture_->commands_.push_back(std::move(command));
+    return;
+  }
+  KeepAllocation(src);
+  KeepAllocation(dst);
+  EnsureEncoder();
+  encoder_.CopyBufferToBuffer(src.data, srcOffset, dst.data, dstOffset, size);
+}
+
+MemoryUsage Device::GetMemoryUsage() const {
+  return memory_->GetUsage();
+}
+
+MemoryUsage Device::GetMemoryUsage(MemoryCategory category) const {
+  return memory_->GetUsage(category);
+}
+
+void Device::ResetPeakMemoryUsage() {
+  memory_->ResetPeak();
+}
+
+void Device::SetMemoryBudget(uint64_t bytes) {
+  memory_->SetBudget(bytes);
+}
+
+void Device::SetSoftMemoryBudget(uint64_t bytes, SoftMemoryBudgetCallback cb) {
+  memory_->SetSoftBudget(bytes, std::move(cb));
+}
+
+void Device::BeginCapture() {
+  if (capture_)
+    throw std::runtime_error("BeginCapture called while already capturing.");
+  capture_ = std::make_unique<CommandGraph>();
+}
+
+CommandGraph Device::EndCapture() {
+  if (!capture_)
+    throw std::runtime_error("EndCapture called without BeginCapture.");
+  CommandGraph graph = std::move(*capture_);
+  capture_.reset();
+  capturedBindGroups_.clear();
+  return graph;
+}
+
+void Device::Replay(CommandGraph& graph, const std::vector<Buffer>& bindings) {
+  if (capture_)
+    throw std::runtime_error("Can not replay while capturing commands.");
+  // Replace the bindings that have changed since last replay.
+  if (!bindings.empty()) {
+    if (bindings.size() != graph.bindings_.size()) {
+      throw std::runtime_error(
+          fmt::format("Replay expects {} bindings but got {}.",
+                      graph.bindings_.size(), bindings.size()));
+    }
+    std::set<size_t> dirty;
+    for (size_t i = 0; i < bindings.size(); ++i) {
+      const Buffer& old = graph.bindings_[i];
+      const Buffer& binding = bindings[i];
+      if (binding.data.Get() == old.data.Get() &&
+          binding.offset == old.offset &&
+          binding.size == old.size) {
+        continue;
+      }
+      for (auto [c, b] : graph.bindingUses_[i]) {
+        CommandGraph::Command& command = graph.commands_[c];
+        // Copies carry their own offsets.
+        uint64_t offset = command.buffers[b].offset;
+        command.buffers[b] = binding;
+        if (!command.kernel)
+          command.buffers[b].offset = offset;
+        dirty.insert(c);
+      }
+      graph.bindings_[i] = binding;
+    }
+    for (size_t c : dirty) {
+      CommandGraph::Command& command = graph.commands_[c];
+      if (command.kernel)
+        command.bindGroup = CreateBindGroup(command.kernel, command.buffers);
+    }
+  }
+  // Encode the commands, with consecutive dispatches in one pass.
+  EnsureEncoder();
+  wgpu::ComputePassEncoder pass;
+  for (const CommandGraph::Command& command : graph.commands_) {
+    for (const Buffer& buffer : command.buffers)
+      KeepAllocation(buffer);
+    if (command.kernel) {
+      if (!pass)
+        pass = encoder_.BeginComputePass();
+      pass.SetPipeline(command.kernel);
+      pass.SetBindGroup(0, command.bindGroup);
+      pass.DispatchWorkgroups(command.workgroupsCount.x,
+                              command.workgroupsCount.y,
+                              command.workgroupsCount.z);
+    } else {
+      if (pass) {
+        pass.End();
+        pass = nullptr;
+      }
+      encoder_.CopyBufferToBuffer(command.buffers[0].data,
+                                  command.buffers[0].offset,
+                                  command.buffers[1].data,
+                                  command.buffers[1].offset,
+                                  command.copySize);
+    }
+  }
+  if (pass)
+    pass.End();
+}
+
 void Device::EnsureEncoder() {
   if (!encoder_)
     encoder_ = device_.CreateCommandEncoder();
@@ -294,6 +607,7 @@ void Device::EndEncoding() {
 
 Buffer Device::CopyToStagingBuffer(const Buffer& buffer) {
   uint64_t totalSize = buffer.GetSize();
+  MemoryScope memoryScope(*this, MemoryCategory::Staging);
   Buffer staging = CreateBuffer(totalSize, BufferUsage::MapRead |
                                            BufferUsage::CopyDst);
   staging.size = buffer.size;
@@ -303,6 +617,11 @@ Buffer Device::CopyToStagingBuffer(const Buffer& buffer) {
   return staging;
 }
 
+void Device::KeepAllocation(const Buffer& buffer) {
+  if (buffer.allocation)
+    pendingAllocations_.push_back(buffer.allocation);
+}
+
 wgpu::Future Device::AddFuture(const wgpu::Future& future) {
   futures_.insert(future.id);
   return future;
@@ -2,6 +2,7 @@
 #define BETANN_DEVICE_H_
 
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <type_traits>
@@ -19,9 +20,84 @@ struct Dims3 {
   uint32_t z = 1;
 };
 
+// Categories for accounting device memory.
+enum class MemoryCategory {
+  // Buffers created by users.
+  UserBuffers,
+  // Uniforms, shapes and strides created for running kernels, which are the
+  // buffers created from structs, vectors and scalars.
+  Parameters,
+  // Temporary results created by ops.
+  Intermediates,
+  // Buffers used for transfering data between host and device.
+  Staging,
+};
+
+struct MemoryUsage {
+  uint64_t current = 0;
+  uint64_t peak = 0;
+};
+
+class MemoryTracker;
+
+// Return all the adapters that can be used for creating devices. Each call
+// enumerates on a new instance, and as an adapter can only create one device,
+// calling it again is the way to create multiple devices on one physical
+// adapter.
+std::vector<wgpu::Adapter> EnumerateAdapters();
+
+// Commands recorded between Device::BeginCapture and Device::EndCapture, which
+// can be replayed without redoing the work of creating them.
+class CommandGraph {
+ public:
+  CommandGraph();
+  ~CommandGraph();
+
+  CommandGraph(CommandGraph&&);
+  CommandGraph& operator=(CommandGraph&&);
+
+  // Declare the buffers used by recorded commands that can be replaced when
+  // replaying, the buffers passed to Device::Replay must be in same order.
+  void DeclareBindings(std::vector<Buffer> bindings);
+
+  size_t GetCommandCount() const { return commands_.size(); }
+
+ private:
+  friend class Device;
+
+  struct Command {
+    // Either a dispatch or a copy from buffers[0] to buffers[1].
+    wgpu::ComputePipeline kernel;
+    wgpu::BindGroup bindGroup;
+    std::vector<Buffer> buffers;
+    Dims3 workgroupsCount;
+    uint64_t copySize = 0;
+  };
+
+  // Where a binding is used: index of command and index of buffer.
+  using BindingUses = std::vector<std::pair<size_t, size_t>>;
+
+  std::vector<Command> commands_;
+  std::vector<Buffer> bindings_;
+  std::vector<BindingUses> bindingUses_;
+};
+
 class Device {
  public:
+  // Account the buffers created in the scope in |category|.
+  class MemoryScope {
+   public:
+    MemoryScope(Device& device, MemoryCategory category);
+    ~MemoryScope();
+
+   private:
+    Device& device_;
+    MemoryCategory previous_;
+  };
+
   Device();
+  // Create the device from an adapter returned by EnumerateAdapters.
+  explicit Device(wgpu::Adapter adapter);
   ~Device();
 
   wgpu::Future OnSubmittedWorkDone(std::function<void()> cb);
@@ -36,10 +112,13 @@ class Device {
                               uint64_t size,
                               BufferUsage usage = BufferUsage::Storage);
 
+  // The buffers created from structs, vectors and scalars are used as the
+  // parameters of kernels, and they are always accounted in
+  // MemoryCategory::Parameters.
   template<typename T>
   Buffer CreateBufferFromStruct(const T& obj,
                                 BufferUsage usage = BufferUsage::Storage) {
-    return CreateBufferFromData(&obj, sizeof(T), usage);
+    return CreateParametersBuffer(&obj, sizeof(T), usage);
   }
 
   template<typename T>
@@ -47,7 +126,7 @@ class Device {
                                 DataType dataType = GetDataType<T>(),
                                 BufferUsage usage = BufferUsage::Storage) {
     assert(sizeof(T) == SizeOf(dataType));
-    return CreateBufferFromData(vec.data(), vec.size() * sizeof(T), usage);
+    return CreateParametersBuffer(vec.data(), vec.size() * sizeof(T), usage);
   }
 
   template<typename T, typename = std::enable_if_t<std::is_scalar_v<T>>>
@@ -55,24 +134,24 @@ class Device {
                                 DataType dataType = GetDataType<T>(),
                                 BufferUsage usage = BufferUsage::Uniform) {
     if (sizeof(T) == SizeOf(dataType))
-      return CreateBufferFromData(&data, sizeof(T), usage);
+      return CreateParametersBuffer(&data, sizeof(T), usage);
     switch (dataType) {
       case DataType::Bool:
       case DataType::U32: {
         uint32_t native = static_cast<uint32_t>(data);
-        return CreateBufferFromData(&native, SizeOf(dataType), usage);
+        return CreateParametersBuffer(&native, SizeOf(dataType), usage);
       }
       case DataType::I32: {
         int32_t native = static_cast<int32_t>(data);
-        return CreateBufferFromData(&native, SizeOf(dataType), usage);
+        return CreateParametersBuffer(&native, SizeOf(dataType), usage);
       }
       case DataType::F32: {
         float native = static_cast<float>(data);
-        return CreateBufferFromData(&native, SizeOf(dataType), usage);
+        return CreateParametersBuffer(&native, SizeOf(dataType), usage);
       }
       case DataType::F16: {
         uint64_t native = Float32ToFloat16(static_cast<float>(data));
-        return CreateBufferFromData(&native, SizeOf(dataType), usage);
+        return CreateParametersBuffer(&native, SizeOf(dataType), usage);
       }
     }
   }
@@ -114,6 +193,33 @@ class Device {
   void RunKernel(const wgpu::ComputePipeline& kernel,
                  const wgpu::BindGroup& bindGroup,
                  Dims3 workgroupsCount);
+  void CopyBufferToBuffer(const Buffer& src,
+                          uint64_t srcOffset,
+                          const Buffer& dst,
+                          uint64_t dstOffset,
+                          uint64_t size);
+
+  // Record the kernels and copies instead of running them, until EndCapture is
+  // called. Buffers can not be read while capturing.
+  void BeginCapture();
+  CommandGraph EndCapture();
+  // Encode the recorded commands, with the declared bindings of |graph|
+  // replaced by |bindings| when it is not empty.
+  void Replay(CommandGraph& graph, const std::vector<Buffer>& bindings = {});
+  bool IsCapturing() const { return capture_ != nullptr; }
+
+  // Bytes held by the buffers created from this device, a buffer is released
+  // when all the copies of it are destroyed and the submitted commands using
+  // it have completed.
+  MemoryUsage GetMemoryUsage() const;
+  MemoryUsage GetMemoryUsage(MemoryCategory category) const;
+  void ResetPeakMemoryUsage();
+  // Creating buffers exceeding the budget throws, 0 means no limit.
+  void SetMemoryBudget(uint64_t bytes);
+  // Call |cb| with current usage when a new buffer makes the usage go over
+  // |bytes|, which gives a chance to free memory before running out of it.
+  using SoftMemoryBudgetCallback = std::function<void(uint64_t usage)>;
+  void SetSoftMemoryBudget(uint64_t bytes, SoftMemoryBudgetCallback cb);
 
   const wgpu::AdapterInfo& GetAdapterInfo() const { return adapterInfo_; }
   const wgpu::Limits& GetLimits() const { return limits_; }
@@ -124,7 +230,11 @@ class Device {
  private:
   void EnsureEncoder();
   void EndEncoding();
+  Buffer CreateParametersBuffer(const void* data,
+                                uint64_t size,
+                                BufferUsage usage);
   Buffer CopyToStagingBuffer(const Buffer& buffer);
+  void KeepAllocation(const Buffer& buffer);
   wgpu::Future AddFuture(const wgpu::Future& future);
 
   static void PollingThread(Device* self);
@@ -157,6 +267,16 @@ class Device {
 
   // Tasks to be waited for.
   std::set<uint64_t> futures_;
+
+  // Memory accounting, shared with the allocations which can outlive device.
+  std::shared_ptr<MemoryTracker> memory_;
+  MemoryCategory memoryCategory_ = MemoryCategory::UserBuffers;
+  // Allocations of the buffers used by unsubmitted commands.
+  std::vector<std::shared_ptr<void>> pendingAllocations_;
+
+  // The graph being captured, and buffers of the bind groups created in it.
+  std::unique_ptr<CommandGraph> capture_;
+  std::map<WGPUBindGroup, std::vector<Buffer>> capturedBindGroups_;
 };
 
 }  // namespace betann
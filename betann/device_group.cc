@@ -0,0 +1,191 @@
+#include "betann/device_group.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "betann/matmul.h"
+#include "betann/reduce.h"
+
+namespace betann {
+
+namespace {
+
+// Copy host data into a new buffer, the size is padded to a multiple of 4 as
+// required by mapping.
+Buffer UploadSlice(Device& device, const void* data, uint64_t size) {
+  Buffer buffer = device.CreateBuffer(DivCeil(size, 4u) * 4,
+                                      BufferUsage::Storage,
+                                      true);
+  std::memcpy(buffer.data.GetMappedRange(), data, size);
+  buffer.data.Unmap();
+  return buffer;
+}
+
+// Run |runShard| on each device with its range of batches, and gather the
+// results into |out|.
+template<typename F>
+void RunSharded(DeviceGroup& group,
+                uint32_t numBatches,
+                uint64_t outBatchSize,
+                void* out,
+                F&& runShard) {
+  std::vector<std::pair<Device*, wgpu::Future>> reads;
+  auto shards = group.ShardBatches(numBatches);
+  for (size_t i = 0; i < shards.size(); ++i) {
+    auto [begin, end] = shards[i];
+    if (begin == end)
+      continue;
+    Device& device = group.GetDevice(i);
+    uint64_t size = (end - begin) * outBatchSize;
+    Buffer output = device.CreateBuffer(
+        DivCeil(size, 4u) * 4,
+        BufferUsage::Storage | BufferUsage::CopySrc);
+    runShard(device, begin, end, output);
+    // Reading submits the commands, so the devices run in parallel while the
+    // following shards are being encoded.
+    char* dst = static_cast<char*>(out) + begin * outBatchSize;
+    reads.emplace_back(&device, device.ReadBuffer(
+        output,
+        [dst, size](const void* data, uint64_t, uint64_t) {
+          std::memcpy(dst, data, size);
+        }));
+  }
+  for (auto& [device, future] : reads)
+    device->WaitFor(future);
+}
+
+}  // namespace
+
+DeviceGroup::DeviceGroup() : DeviceGroup(EnumerateAdapters()) {}
+
+DeviceGroup::DeviceGroup(std::vector<wgpu::Adapter> adapters) {
+  if (adapters.empty())
+    throw std::runtime_error("There is no adapter for creating DeviceGroup.");
+  for (wgpu::Adapter& adapter : adapters)
+    devices_.push_back(std::make_unique<Device>(std::move(adapter)));
+}
+
+DeviceGroup::~DeviceGroup() = default;
+
+std::vector<std::pair<uint32_t, uint32_t>> DeviceGroup::ShardBatches(
+    uint32_t numBatches) const {
+  uint32_t batchesPerDevice = DivCeil(numBatches, devices_.size());
+  std::vector<std::pair<uint32_t, uint32_t>> shards;
+  for (size_t i = 0; i < devices_.size(); ++i) {
+    shards.emplace_back(
+        std::min<uint64_t>(i * batchesPerDevice, numBatches),
+        std::min<uint64_t>((i + 1) * batchesPerDevice, numBatches));
+  }
+  return shards;
+}
+
+void DeviceGroup::Flush() {
+  for (auto& device : devices_)
+    device->Flush();
+}
+
+void DeviceGroup::WaitAll() {
+  for (auto& device : devices_)
+    device->WaitAll();
+}
+
+void MatrixVectorMultiply(DeviceGroup& group,
+                          DataType dataType,
+                          uint32_t numBatches,
+                          void* out,
+                          const void* mat,
+                          bool matTranspose,
+                          uint32_t matRows,
+                          uint32_t matCols,
+                          const void* vec,
+                          bool disableSubgroups) {
+  uint32_t outSize = matTranspose ? matCols : matRows;
+  uint32_t vecSize = matTranspose ? matRows : matCols;
+  uint64_t matBatchSize = uint64_t(matRows) * matCols * SizeOf(dataType);
+  uint64_t vecBatchSize = uint64_t(vecSize) * SizeOf(dataType);
+  RunSharded(
+      group, numBatches, outSize * SizeOf(dataType), out,
+      [&](Device& device, uint32_t begin, uint32_t end, const Buffer& output) {
+        uint32_t count = end - begin;
+        MatrixVectorMultiply(
+            device,
+            dataType,
+            {count},
+            output,
+            UploadSlice(device,
+                        static_cast<const char*>(mat) + begin * matBatchSize,
+                        count * matBatchSize),
+            matTranspose,
+            matRows,
+            matCols,
+            matCols,
+            {matRows * matCols},
+            UploadSlice(device,
+                        static_cast<const char*>(vec) + begin * vecBatchSize,
+                        count * vecBatchSize),
+            {vecSize},
+            disableSubgroups);
+      });
+}
+
+void ReduceLast(DeviceGroup& group,
+                ReduceType type,
+                DataType outputDataType,
+                void* output,
+                uint32_t outputNumElements,
+                DataType inputDataType,
+                const void* input,
+                uint32_t rowSize,
+                bool disableSubgroups) {
+  uint64_t rowBytes = uint64_t(rowSize) * SizeOf(inputDataType);
+  RunSharded(
+      group, outputNumElements, SizeOf(outputDataType), output,
+      [&](Device& device, uint32_t begin, uint32_t end, const Buffer& out) {
+        uint32_t count = end - begin;
+        ReduceLast(device,
+                   type,
+                   outputDataType,
+                   out,
+                   count,
+                   inputDataType,
+                   UploadSlice(device,
+                               static_cast<const char*>(input) +
+                                   begin * rowBytes,
+                               count * rowBytes),
+                   rowSize,
+                   disableSubgroups);
+      });
+}
+
+void SortBlock(DeviceGroup& group,
+               SortResultType resultType,
+               void* out,
+               DataType inputDataType,
+               const void* input,
+               uint32_t numSegments,
+               uint32_t segmentSize) {
+  uint64_t segmentBytes = uint64_t(segmentSize) * SizeOf(inputDataType);
+  uint64_t outSegmentBytes = resultType == SortResultType::Indices
+                                 ? uint64_t(segmentSize) * sizeof(uint32_t)
+                                 : segmentBytes;
+  RunSharded(
+      group, numSegments, outSegmentBytes, out,
+      [&](Device& device, uint32_t begin, uint32_t end, const Buffer& output) {
+        uint32_t count = end - begin;
+        SortBlock(device,
+                  1,
+                  SortInputType::Contiguous,
+                  resultType,
+                  output,
+                  {segmentSize, 1},
+                  inputDataType,
+                  UploadSlice(device,
+                              static_cast<const char*>(input) +
+                                  begin * segmentBytes,
+                              count * segmentBytes),
+                  {count, segmentSize},
+                  {segmentSize, 1});
+      });
+}
+
+}  // namespace betann
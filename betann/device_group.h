@@ -0,0 +1,73 @@
+#ifndef BETANN_DEVICE_GROUP_H_
+#define BETANN_DEVICE_GROUP_H_
+
+#include <memory>
+#include <utility>
+
+#include "betann/kernels.h"
+
+namespace betann {
+
+// Own multiple devices and split batched work among them.
+class DeviceGroup {
+ public:
+  // Create one device for each adapter returned by EnumerateAdapters.
+  DeviceGroup();
+  // Create one device for each of the adapters. Note that an adapter can only
+  // be used to create one device, so the adapters of one physical adapter must
+  // come from separate calls of EnumerateAdapters.
+  explicit DeviceGroup(std::vector<wgpu::Adapter> adapters);
+  ~DeviceGroup();
+
+  // Split batches into contiguous [begin, end) ranges, one for each device.
+  std::vector<std::pair<uint32_t, uint32_t>> ShardBatches(
+      uint32_t numBatches) const;
+
+  void Flush();
+  void WaitAll();
+
+  size_t GetDeviceCount() const { return devices_.size(); }
+  Device& GetDevice(size_t index) { return *devices_[index]; }
+
+ private:
+  std::vector<std::unique_ptr<Device>> devices_;
+};
+
+// The helpers below take contiguous host data, run the batches on all the
+// devices of the group, and gather results into |out|.
+
+// Multiply contiguous matrices and vectors in batches.
+void MatrixVectorMultiply(DeviceGroup& group,
+                          DataType dataType,
+                          uint32_t numBatches,
+                          void* out,
+                          const void* mat,
+                          bool matTranspose,
+                          uint32_t matRows,
+                          uint32_t matCols,
+                          const void* vec,
+                          bool disableSubgroups = false);
+
+// Reduce the last dimension, with rows split among devices.
+void ReduceLast(DeviceGroup& group,
+                ReduceType type,
+                DataType outputDataType,
+                void* output,
+                uint32_t outputNumElements,
+                DataType inputDataType,
+                const void* input,
+                uint32_t rowSize,
+                bool disableSubgroups = false);
+
+// Sort contiguous segments, with segments split among devices.
+void SortBlock(DeviceGroup& group,
+               SortResultType resultType,
+               void* out,
+               DataType inputDataType,
+               const void* input,
+               uint32_t numSegments,
+               uint32_t segmentSize);
+
+}  // namespace betann
+
+#endif  // BETANN_DEVICE_GROUP_H_
@@ -392,90 +392,6 @@ void RandomBitsGeneral(Device& device,
             workgroupsCount);
 }
 
-uint32_t SortBlockSize() {
-  const uint32_t workgroupSize = 256;  // TODO(zcbenz): make it dynamic
-  const uint32_t workPerThread = 8;
-  return  workgroupSize * workPerThread;
-}
-
-void SortBlock(Device& device,
-               uint32_t axis,
-               SortInputType inputType,
-               SortResultType resultType,
-               const Buffer& out,
-               const std::vector<uint32_t>& outStrides,
-               DataType inputDataType,
-               const Buffer& input,
-               const std::vector<uint32_t>& inputShape,
-               const std::vector<uint32_t>& inputStrides) {
-  uint32_t sizeSortedAxis = inputShape[axis];
-  if (sizeSortedAxis > SortBlockSize()) {
-    throw std::runtime_error(
-        fmt::format("Elements number of sorted axis ({}) exceeds limit ({}).",
-                    sizeSortedAxis, SortBlockSize()));
-  }
-  auto removeAxis = [](const std::vector<uint32_t>& input, uint32_t axis) {
-    auto ret = input;
-    ret.erase(ret.begin() + axis);
-    return ret;
-  };
-  std::vector<Buffer> buffers = {
-      out,
-      device.CreateBufferFromScalar(sizeSortedAxis),
-      device.CreateBufferFromScalar(outStrides[axis]),
-      input,
-      device.CreateBufferFromScalar(inputStrides[axis]),
-  };
-  auto outRestStrides = removeAxis(outStrides, axis);
-  auto inputRestStrides = removeAxis(inputStrides, axis);
-  bool contiguous = inputType == SortInputType::Contiguous;
-  if (contiguous) {
-    buffers.push_back(device.CreateBufferFromScalar(
-        *std::min_element(outRestStrides.begin(), outRestStrides.end())));
-    buffers.push_back(device.CreateBufferFromScalar(
-        *std::min_element(inputRestStrides.begin(), inputRestStrides.end())));
-  } else {
-    auto inputRestShape = removeAxis(inputShape, axis);
-    if (inputRestShape.empty()) {
-      Buffer zero = device.CreateBufferFromScalar(
-          0, DataType::U32, BufferUsage::Storage);
-      buffers.push_back(zero);
-      buffers.push_back(zero);
-      buffers.push_back(zero);
-    } else {
-      buffers.push_back(device.CreateBufferFromVector(outRestStrides));
-      buffers.push_back(device.CreateBufferFromVector(inputRestShape));
-      buffers.push_back(device.CreateBufferFromVector(inputRestStrides));
-    }
-  }
-  bool argsort = resultType == SortResultType::Indices;
-  RunKernel(device,
-            "sort_block",
-            fmt::format("sort_{}_{}_{}",
-                        WgslType(inputDataType),
-                        argsort,
-                        contiguous),
-            [&]() {
-              bool enableF16 = EnableF16(device, inputDataType);
-              return Append(
-                  ParseTemplate(wgsl_source_sort_block,
-                                {
-                                  {"enable_f16", enableF16},
-                                  {"dtype", WgslType(inputDataType)},
-                                  {"argsort", argsort},
-                                  {"contiguous", contiguous},
-                                }),
-                  wgsl_source_utils,
-                  ParseTemplate(wgsl_source_constants,
-                                {
-                                  {"enable_f16", enableF16},
-                                  {"dtype", WgslType(inputDataType)},
-                                }));
-            },
-            buffers,
-            {1, NumElements(inputShape) / sizeSortedAxis, 1});
-}
-
 void UnaryOpContiguous(Device& device,
                        const char* name,
                        DataType outputDataType,
@@ -83,6 +83,20 @@ void CopyGeneralBoth(Device& device,
                      const std::vector<uint32_t>& srcShape,
                      const std::vector<uint32_t>& srcStrides);
 
+// Operations fused into matrix multiplication, the output is computed as:
+// out = activation(alpha * (a @ b) + beta * residual + bias)
+struct MatmulEpilogue {
+  // The scales are converted to the data type of matrices.
+  float alpha = 1;
+  float beta = 1;
+  // A vector broadcasted to all rows of output.
+  Buffer bias;
+  // A contiguous array with the same shape as output.
+  Buffer residual;
+  // Name of a unary op like "silu", "gelu" or "tanh".
+  const char* activation = nullptr;
+};
+
 // Multiply contiguous matrix.
 void MatrixMultiply(Device& device,
                     DataType dataType,
@@ -92,7 +106,8 @@ void MatrixMultiply(Device& device,
                     const std::vector<uint32_t>& aStrides,
                     Buffer b,
                     const std::vector<uint32_t>& bShape,
-                    const std::vector<uint32_t>& bStrides);
+                    const std::vector<uint32_t>& bStrides,
+                    const MatmulEpilogue& epilogue = {});
 
 // Generate random bits from contiguous keys.
 void RandomBitsContiguous(Device& device,
@@ -124,13 +139,44 @@ struct ReductionPlan {
   std::vector<uint32_t> reductionStrides;
 };
 
+// Find the fastest way to reduce the sorted |axes| of input, the reduction
+// dims of size 1 are dropped and the contiguous ones are collapsed. When
+// |keepOrder| is true the reduction dims are not reordered, which is required
+// by the reductions that depend on the order of elements like ArgMin.
+ReductionPlan GetReductionPlan(const std::vector<uint32_t>& shape,
+                               const std::vector<uint32_t>& strides,
+                               const std::vector<uint32_t>& axes,
+                               bool keepOrder = false);
+
 enum class ReduceType {
   And,
   Or,
   Sum,
   Prod,
   Min,
-  Max
+  Max,
+  // Write the index of min/max element in the reduction, the ties are resolved
+  // to the first index.
+  ArgMin,
+  ArgMax,
+  // Write the mean to output, and the population variance to the values when
+  // requested, accumulated in f32 with Welford's algorithm.
+  MeanVariance,
+  // Write log(sum(exp(x))), computed in one pass by rescaling the sum of a
+  // running max.
+  LogSumExp,
+};
+
+// Elementwise ops fused into reduction, which are applied to each element of
+// input before reducing it:
+// out = reduce(unaryOp(binaryOp(input, other)))
+struct ReducePrologue {
+  // Name of a binary op like "multiply" or "subtract", and its second input,
+  // which has the same data type and layout with input.
+  const char* binaryOp = nullptr;
+  Buffer other;
+  // Name of a unary op like "abs" or "square".
+  const char* unaryOp = nullptr;
 };
 
 void Reduce(Device& device,
@@ -144,7 +190,22 @@ void Reduce(Device& device,
             uint32_t inputNumElements,
             const std::vector<uint32_t>& inputShape,
             const std::vector<uint32_t>& inputStrides,
-            const std::vector<uint32_t>& reductionAxes);
+            const std::vector<uint32_t>& reductionAxes,
+            const ReducePrologue& prologue = {});
+
+// Reduce with the plan got from GetReductionPlan.
+void Reduce(Device& device,
+            ReduceType type,
+            DataType outputDataType,
+            const Buffer& output,
+            uint32_t outputNumElements,
+            DataType inputDataType,
+            const Buffer& input,
+            uint32_t inputNumElements,
+            const std::vector<uint32_t>& inputShape,
+            const std::vector<uint32_t>& inputStrides,
+            const std::vector<uint32_t>& reductionAxes,
+            const ReducePrologue& prologue = {});
 
 // Maximum number of elements can sort in one block.
 uint32_t SortBlockSize();
@@ -176,6 +237,37 @@ void SortBlock(Device& device,
                const std::vector<uint32_t>& inputShape,
                const std::vector<uint32_t>& inputStrides);
 
+// Sort input or return the indices that would sort it, merging sorted blocks
+// when elements in axis can not fit in one block.
+void Sort(Device& device,
+          uint32_t axis,
+          SortInputType inputType,
+          SortResultType resultType,
+          const Buffer& out,
+          const std::vector<uint32_t>& outStrides,
+          DataType inputDataType,
+          const Buffer& input,
+          const std::vector<uint32_t>& inputShape,
+          const std::vector<uint32_t>& inputStrides);
+
+// Find the k largest elements along axis, and write their values and indices
+// into output whose axis has k elements. Either output can be null, and writing
+// only the indices gives the argpartition of the k largest elements. The
+// results are written in the order of their indices in input, not sorted by
+// value. Floats are ranked by their bits, so a NaN without the sign bit is
+// larger than +inf, a NaN with the sign bit is smaller than -inf, and -0 is
+// smaller than +0. Ties are resolved to the lowest indices.
+void TopK(Device& device,
+          uint32_t axis,
+          uint32_t k,
+          const Buffer& outValues,
+          const Buffer& outIndices,
+          const std::vector<uint32_t>& outStrides,
+          DataType inputDataType,
+          const Buffer& input,
+          const std::vector<uint32_t>& inputShape,
+          const std::vector<uint32_t>& inputStrides);
+
 // Run unary operations on contiguous input.
 void UnaryOpContiguous(Device& device,
                        const char* name,
@@ -1,9 +1,11 @@
 #include "betann/matmul.h"
 
+#include <algorithm>
+
 #include <fmt/format.h>
 
-#include "betann/kernels.h"
 #include "betann/kernels_helper.h"
+#include "betann/reduce.h"
 #include "wgsl_sources.h"
 
 namespace betann {
@@ -23,33 +25,204 @@ NeedsContiguousCopy(const std::vector<uint32_t>& shape,
   return {false, true, shape[shape.size() - 1]};
 }
 
+// Copy the array into contiguous memory, except that broadcasted batch dims
+// stay broadcasted instead of being materialized. The |strides| are updated
+// to the ones of the copied array.
 Buffer CopyArray(Device& device,
                  DataType dataType,
                  const Buffer& src,
                  const std::vector<uint32_t>& shape,
-                 const std::vector<uint32_t>& strides) {
+                 std::vector<uint32_t>& strides) {
+  std::vector<uint32_t> copyShape = shape;
+  for (size_t i = 0; i < shape.size() - 2; ++i) {
+    if (strides[i] == 0)
+      copyShape[i] = 1;
+  }
+  Device::MemoryScope memoryScope(device, MemoryCategory::Intermediates);
   Buffer dst = device.CreateBuffer(
-      NumElements(shape) * SizeOf(dataType),
+      NumElements(copyShape) * SizeOf(dataType),
       BufferUsage::Storage | BufferUsage::CopyDst);
-  CopyGeneral(device, dataType, dst, dataType, src, shape, strides);
+  CopyGeneral(device, dataType, dst, dataType, src, copyShape, strides);
+  uint32_t stride = 1;
+  for (size_t i = shape.size(); i-- > 0;) {
+    strides[i] = copyShape[i] == shape[i] ? stride : 0;
+    stride *= copyShape[i];
+  }
   return dst;
 }
 
-}  // namespace
+// When there are at most 64 workgroups, which are too few to occupy the GPU,
+// split the reduction dimension among about 128 workgroups. Return the size of
+// each split, or 0 if the reduction should not be split.
+uint32_t GetSplitSize(uint32_t workgroupsCount, uint32_t reductionSize) {
+  const uint32_t maxWorkgroupsCountToSplit = 64;
+  const uint32_t targetWorkgroupsCount = 128;
+  const uint32_t minSplitSize = 1024;
+  if (workgroupsCount > maxWorkgroupsCountToSplit ||
+      reductionSize < 2 * minSplitSize) {
+    return 0;
+  }
+  uint32_t maxSplitCount = DivCeil(targetWorkgroupsCount, workgroupsCount);
+  uint32_t splitSize = minSplitSize;
+  while (splitSize * maxSplitCount < reductionSize)
+    splitSize *= 2;
+  return splitSize;
+}
 
-void MatrixVectorMultiply(Device& device,
-                          DataType dataType,
-                          const std::vector<uint32_t>& batchShape,
-                          const Buffer& out,
-                          const Buffer& mat,
-                          bool matTranspose,
-                          uint32_t matRows,
+// Create the buffer for partial results of splits, which are laid out as
+// [output][split] so they can be summed by ReduceLast.
+Buffer CreatePartialsBuffer(Device& device,
+                            DataType dataType,
+                            uint32_t outNumElements,
+                            uint32_t splitCount) {
+  Device::MemoryScope memoryScope(device, MemoryCategory::Intermediates);
+  return device.CreateBuffer(outNumElements * splitCount * SizeOf(dataType),
+                             BufferUsage::Storage);
+}
+
+bool HasEpilogue(const MatmulEpilogue& epilogue) {
+  return epilogue.alpha != 1 ||
+         epilogue.bias ||
+         epilogue.residual ||
+         epilogue.activation;
+}
+
+std::string GetEpilogueKey(const MatmulEpilogue& epilogue) {
+  if (!HasEpilogue(epilogue))
+    return "none";
+  return fmt::format("{}_{}_{}",
+                     static_cast<bool>(epilogue.bias),
+                     static_cast<bool>(epilogue.residual),
+                     epilogue.activation ? epilogue.activation : "none");
+}
+
+void CheckMatmulEpilogue(DataType dataType, const MatmulEpilogue& epilogue) {
+  if (epilogue.activation && !IsFloating(dataType))
+    throw std::runtime_error("Activation only supports floating types.");
+}
+
+// Append the buffers used by |epilogue| to |buffers|, and return the template
+// variables of epilogue.wgsl. When |scalarBias| is true the bias has only one
+// element.
+VariablesMap AddEpilogueBuffers(Device& device,
+                                const MatmulEpilogue& epilogue,
+                                std::vector<Buffer>& buffers,
+                                bool scalarBias = false) {
+  VariablesMap variables = {
+    {"has_epilogue", HasEpilogue(epilogue)},
+    {"has_bias", static_cast<bool>(epilogue.bias)},
+    {"has_residual", static_cast<bool>(epilogue.residual)},
+    {"has_activation", epilogue.activation != nullptr},
+    {"activation", epilogue.activation ? epilogue.activation : ""},
+  };
+  if (!HasEpilogue(epilogue))
+    return variables;
+  // The bindings are assigned sequentially to the non-null buffers.
+  uint32_t binding = std::count_if(buffers.begin(), buffers.end(),
+                                   [](const Buffer& b) { return !!b; });
+  struct {
+    float alpha;
+    float beta;
+    uint32_t biasStride;
+  } params = {epilogue.alpha, epilogue.beta, scalarBias ? 0u : 1u};
+  variables["params_binding"] = binding++;
+  buffers.push_back(device.CreateBufferFromStruct(params,
+                                                  BufferUsage::Uniform));
+  if (epilogue.bias) {
+    variables["bias_binding"] = binding++;
+    buffers.push_back(epilogue.bias);
+  }
+  if (epilogue.residual) {
+    variables["residual_binding"] = binding++;
+    buffers.push_back(epilogue.residual);
+  }
+  return variables;
+}
+
+std::string GetEpilogueSource(DataType dataType,
+                              const MatmulEpilogue& epilogue,
+                              const VariablesMap& variables) {
+  std::string source = ParseTemplate(wgsl_source_epilogue, variables);
+  if (epilogue.activation) {
+    source += ParseTemplate(
+        wgsl_source_unary_ops,
+        {
+          {"input_is_bool", false},
+          {"input_is_floating", IsFloating(dataType)},
+          {"input_is_unsigned", IsUnsigned(dataType)},
+        });
+  }
+  return source;
+}
+
+void CheckQuantizedMatrix(DataType dataType,
                           uint32_t matCols,
-                          uint32_t matRowStride,
-                          const std::vector<uint32_t>& batchStridesMat,
-                          const Buffer& vec,
-                          const std::vector<uint32_t>& batchStridesVec,
-                          bool disableSubgroups) {
+                          uint32_t groupSize,
+                          uint32_t bits) {
+  if (!IsFloating(dataType))
+    throw std::runtime_error("Quantized matmul only supports floating types.");
+  if (bits != 2 && bits != 3 && bits != 4 && bits != 6 && bits != 8) {
+    throw std::runtime_error(
+        fmt::format("Unsupported quantization bits: {}.", bits));
+  }
+  if (groupSize != 32 && groupSize != 64 && groupSize != 128) {
+    throw std::runtime_error(
+        fmt::format("Unsupported quantization group size: {}.", groupSize));
+  }
+  if (matCols % groupSize != 0) {
+    throw std::runtime_error(
+        fmt::format("The matrix cols {} must be a multiple of group size {}.",
+                    matCols, groupSize));
+  }
+}
+
+// Return the shape that both batch shapes broadcast to.
+std::vector<uint32_t> BroadcastShapes(const std::vector<uint32_t>& a,
+                                      const std::vector<uint32_t>& b) {
+  std::vector<uint32_t> shape(std::max(a.size(), b.size()));
+  for (size_t i = 0; i < shape.size(); ++i) {
+    uint32_t aDim = i < a.size() ? a[a.size() - 1 - i] : 1;
+    uint32_t bDim = i < b.size() ? b[b.size() - 1 - i] : 1;
+    if (aDim != bDim && aDim != 1 && bDim != 1)
+      throw std::runtime_error("Matrices have incorrectly broadcasted shapes.");
+    shape[shape.size() - 1 - i] = std::max(aDim, bDim);
+  }
+  return shape;
+}
+
+// Return the strides of an operand broadcasted to |shape|, the broadcasted
+// dims have 0 stride.
+std::vector<uint32_t> BroadcastStrides(const std::vector<uint32_t>& shape,
+                                       const std::vector<uint32_t>& opShape,
+                                       const std::vector<uint32_t>& opStrides) {
+  std::vector<uint32_t> strides(shape.size(), 0);
+  size_t offset = shape.size() - opShape.size();
+  for (size_t i = 0; i < opShape.size(); ++i) {
+    if (opShape[i] == shape[i + offset])
+      strides[i + offset] = opStrides[i];
+  }
+  return strides;
+}
+
+// The MatrixVectorMultiply used by MatrixMultiply, where the bias of
+// |epilogue| is a single value broadcasted to all elements of output when
+// |scalarBias| is true.
+void RunMatrixVectorMultiply(Device& device,
+                             DataType dataType,
+                             const std::vector<uint32_t>& batchShape,
+                             const Buffer& out,
+                             const Buffer& mat,
+                             bool matTranspose,
+                             uint32_t matRows,
+                             uint32_t matCols,
+                             uint32_t matRowStride,
+                             const std::vector<uint32_t>& batchStridesMat,
+                             const Buffer& vec,
+                             const std::vector<uint32_t>& batchStridesVec,
+                             bool disableSubgroups,
+                             const MatmulEpilogue& epilogue,
+                             bool scalarBias) {
+  CheckMatmulEpilogue(dataType, epilogue);
 #ifndef __APPLE__
   // There is no way to control subgroup size and it is usually too small for
   // gemvt kernel.
@@ -78,12 +251,51 @@ void MatrixVectorMultiply(Device& device,
     colWorkPerThread = 4;
   }
 
+  Dims3 workgroupsCount = {
+    matTranspose
+        ? DivCeil(matCols, colWorkPerThread * groupCount * groupCols)
+        : DivCeil(matRows, rowWorkPerThread * groupCount * groupRows),
+    1,
+    NumElements(batchShape),
+  };
+
+  // Use split-K when there are only a few outputs for a long reduction, which
+  // is not done when there is epilogue as the partials must be summed first.
+  uint32_t outNumElements = (matTranspose ? matCols : matRows) *
+                            NumElements(batchShape);
+  uint32_t reductionSize = matTranspose ? matRows : matCols;
+  uint32_t splitSize = HasEpilogue(epilogue)
+      ? 0
+      : GetSplitSize(workgroupsCount.x * workgroupsCount.z, reductionSize);
+  uint32_t splitCount = splitSize > 0 ? DivCeil(reductionSize, splitSize) : 1;
+  Buffer partials;
+  if (splitCount > 1) {
+    partials = CreatePartialsBuffer(device, dataType, outNumElements,
+                                    splitCount);
+    workgroupsCount.y = splitCount;
+  }
+
   bool contiguous = batchShape.size() < 2;
+  std::vector<Buffer> buffers = {
+    splitCount > 1 ? partials : out,
+    mat,
+    device.CreateBufferFromScalar(matRows),
+    device.CreateBufferFromScalar(matCols),
+    device.CreateBufferFromScalar(matRowStride),
+    batchStridesMat.empty() ? device.CreateBufferFromScalar(0u)
+                            : device.CreateBufferFromVector(batchStridesMat),
+    vec,
+    batchStridesVec.empty() ? device.CreateBufferFromScalar(0u)
+                            : device.CreateBufferFromVector(batchStridesVec),
+    !contiguous ? device.CreateBufferFromVector(batchShape) : nullptr,
+  };
+  VariablesMap epilogueVariables = AddEpilogueBuffers(device, epilogue,
+                                                      buffers, scalarBias);
   bool enableF16 = EnableF16(device, dataType);
   auto capacities = GetCapacityVariables(device, enableF16, disableSubgroups);
   RunKernel(device,
             matTranspose ? "gemvt" : "gemv",
-            fmt::format("gemv_{}_{}_{}_{}_{}_{}_{}_{}_{}",
+            fmt::format("gemv_{}_{}_{}_{}_{}_{}_{}_{}_{}_{}_{}",
                         matTranspose,
                         contiguous,
                         std::get<bool>(capacities["enable_subgroups"]),
@@ -92,7 +304,9 @@ void MatrixVectorMultiply(Device& device,
                         groupRows,
                         groupCols,
                         rowWorkPerThread,
-                        colWorkPerThread),
+                        colWorkPerThread,
+                        splitCount > 1 ? splitSize : 0,
+                        GetEpilogueKey(epilogue)),
             [&]() {
               return Append(
                   ParseTemplate(
@@ -106,32 +320,301 @@ void MatrixVectorMultiply(Device& device,
                         {"group_cols", groupCols},
                         {"row_work_per_thread", rowWorkPerThread},
                         {"col_work_per_thread", colWorkPerThread},
+                        {"split_k", splitCount > 1},
+                        {"split_size", splitSize},
                       },
                       capacities),
+                  GetEpilogueSource(dataType, epilogue, epilogueVariables),
                   wgsl_source_utils);
             },
+            std::move(buffers),
+            workgroupsCount);
+  if (splitCount > 1) {
+    ReduceLast(device, ReduceType::Sum, dataType, out, outNumElements,
+               dataType, partials, splitCount, disableSubgroups);
+  }
+}
+
+}  // namespace
+
+void MatrixVectorMultiply(Device& device,
+                          DataType dataType,
+                          const std::vector<uint32_t>& batchShape,
+                          const Buffer& out,
+                          const Buffer& mat,
+                          bool matTranspose,
+                          uint32_t matRows,
+                          uint32_t matCols,
+                          uint32_t matRowStride,
+                          const std::vector<uint32_t>& batchStridesMat,
+                          const Buffer& vec,
+                          const std::vector<uint32_t>& batchStridesVec,
+                          bool disableSubgroups,
+                          const MatmulEpilogue& epilogue) {
+  RunMatrixVectorMultiply(device, dataType, batchShape, out,
+                          mat, matTranspose, matRows, matCols, matRowStride,
+                          batchStridesMat, vec, batchStridesVec,
+                          disableSubgroups, epilogue, false);
+}
+
+void QuantizedMatrixVectorMultiply(Device& device,
+                                   DataType dataType,
+                                   uint32_t batchSize,
+                                   const Buffer& out,
+                                   const Buffer& mat,
+                                   bool matTranspose,
+                                   uint32_t matRows,
+                                   uint32_t matCols,
+                                   const Buffer& scales,
+                                   const Buffer& biases,
+                                   uint32_t groupSize,
+                                   uint32_t bits,
+                                   const Buffer& vec,
+                                   bool disableSubgroups) {
+  CheckQuantizedMatrix(dataType, matCols, groupSize, bits);
+#ifndef __APPLE__
+  // Same with gemvt, the subgroup size is usually too small.
+  if (matTranspose)
+    disableSubgroups = true;
+#endif
+
+  // Determine the parameters according to data size, each thread always
+  // works on 8 cols.
+  const uint32_t colWorkPerThread = 8;
+  uint32_t groupCount, groupRows, groupCols, rowWorkPerThread;
+  if (matTranspose) {
+    if (matCols >= 2048)
+      groupCount = 16;
+    else if (matCols >= 512)
+      groupCount = 4;
+    else
+      groupCount = 2;
+    groupRows = 8;
+    groupCols = 4;
+    rowWorkPerThread = 4;
+  } else {
+    groupCount = matRows >= 4096 ? 8 : 4;
+    groupRows = 1;  // not used in qgemv
+    groupCols = 32;  // not used in qgemv
+    rowWorkPerThread = matRows < 4 ? 1 : 4;
+  }
+
+  Dims3 workgroupsCount = {
+    matTranspose
+        ? DivCeil(matCols, colWorkPerThread * groupCount * groupCols)
+        : DivCeil(matRows, rowWorkPerThread * groupCount * groupRows),
+    1,
+    batchSize,
+  };
+
+  bool enableF16 = EnableF16(device, dataType);
+  auto capacities = GetCapacityVariables(device, enableF16, disableSubgroups);
+  RunKernel(device,
+            matTranspose ? "qgemvt" : "qgemv",
+            fmt::format("qgemv_{}_{}_{}_{}_{}_{}_{}_{}_{}",
+                        matTranspose,
+                        std::get<bool>(capacities["enable_subgroups"]),
+                        WgslType(dataType),
+                        bits,
+                        groupSize,
+                        groupCount,
+                        groupRows,
+                        groupCols,
+                        rowWorkPerThread),
+            [&]() {
+              return Append(
+                  ParseTemplate(
+                      matTranspose ? wgsl_source_qgemvt : wgsl_source_qgemv,
+                      {
+                        {"dtype", WgslType(dataType)},
+                        {"bits", bits},
+                        {"group_size", groupSize},
+                        {"group_count", groupCount},
+                        {"group_rows", groupRows},
+                        {"group_cols", groupCols},
+                        {"row_work_per_thread", rowWorkPerThread},
+                      },
+                      capacities),
+                  wgsl_source_quantized_ops);
+            },
             {
               out,
               mat,
+              scales,
+              biases,
               device.CreateBufferFromScalar(matRows),
               device.CreateBufferFromScalar(matCols),
-              device.CreateBufferFromScalar(matRowStride),
-              batchStridesMat.empty()
-                  ? device.CreateBufferFromScalar(0u)
-                  : device.CreateBufferFromVector(batchStridesMat),
               vec,
-              batchStridesVec.empty()
-                  ? device.CreateBufferFromScalar(0u)
-                  : device.CreateBufferFromVector(batchStridesVec),
-              !contiguous ? device.CreateBufferFromVector(batchShape) : nullptr,
+            },
+            workgroupsCount);
+}
+
+void QuantizedMatrixMultiply(Device& device,
+                             DataType dataType,
+                             const Buffer& out,
+                             uint32_t M,
+                             const Buffer& x,
+                             const Buffer& mat,
+                             bool matTranspose,
+                             uint32_t matRows,
+                             uint32_t matCols,
+                             const Buffer& scales,
+                             const Buffer& biases,
+                             uint32_t groupSize,
+                             uint32_t bits,
+                             bool disableSubgroups) {
+  // For a few rows it is faster to read the quantized matrix once per row than
+  // dequantizing it into mostly unused tiles.
+  const uint32_t minRowsForTiles = 8;
+  if (M < minRowsForTiles) {
+    QuantizedMatrixVectorMultiply(device, dataType, M, out, mat, matTranspose,
+                                  matRows, matCols, scales, biases, groupSize,
+                                  bits, x, disableSubgroups);
+    return;
+  }
+  CheckQuantizedMatrix(dataType, matCols, groupSize, bits);
+
+  uint32_t N = matTranspose ? matCols : matRows;
+  uint32_t K = matTranspose ? matRows : matCols;
+  // The tiles are fixed to 64x64, which is the (row|col)_work_per_thread times
+  // the workgroup size in qgemm.wgsl.
+  const uint32_t tileSize = 64;
+  bool enableF16 = EnableF16(device, dataType);
+  auto capacities = GetCapacityVariables(device, enableF16, disableSubgroups);
+  RunKernel(device,
+            "qgemm",
+            fmt::format("qgemm_{}_{}_{}_{}_{}",
+                        matTranspose,
+                        std::get<bool>(capacities["enable_subgroups"]),
+                        WgslType(dataType),
+                        bits,
+                        groupSize),
+            [&]() {
+              VariablesMap variables = {
+                {"a_transposed", false},
+                {"mat_transposed", matTranspose},
+                {"dtype", WgslType(dataType)},
+                {"dtype_is_floating", true},
+                {"bits", bits},
+                {"group_size", groupSize},
+              };
+              return Append(
+                  ParseTemplate(wgsl_source_qgemm, variables, capacities),
+                  ParseTemplate(wgsl_source_gemm_ops, variables, capacities),
+                  wgsl_source_quantized_ops);
             },
             {
-              matTranspose
-                  ? DivCeil(matCols, colWorkPerThread * groupCount * groupCols)
-                  : DivCeil(matRows, rowWorkPerThread * groupCount * groupRows),
-              1,
-              NumElements(batchShape),
-            });
+              out,
+              x,
+              mat,
+              scales,
+              biases,
+              device.CreateBufferFromScalar(M),
+              device.CreateBufferFromScalar(N),
+              device.CreateBufferFromScalar(K),
+            },
+            {DivCeil(N, tileSize), DivCeil(M, tileSize), 1});
+}
+
+void GeneralMatrixMultiply(Device& device,
+                           DataType dataType,
+                           const std::vector<uint32_t>& batchShape,
+                           const Buffer& out,
+                           uint32_t M,
+                           uint32_t N,
+                           uint32_t K,
+                           const Buffer& a,
+                           bool aTranspose,
+                           uint32_t aLeadingStride,
+                           const std::vector<uint32_t>& batchStridesA,
+                           const Buffer& b,
+                           bool bTranspose,
+                           uint32_t bLeadingStride,
+                           const std::vector<uint32_t>& batchStridesB,
+                           bool disableSubgroups,
+                           const MatmulEpilogue& epilogue) {
+  CheckMatmulEpilogue(dataType, epilogue);
+  // Use smaller tiles for small matrices to occupy more workgroups.
+  uint32_t rowWorkPerThread = M <= 32 ? 2 : 4;
+  uint32_t colWorkPerThread = N <= 32 ? 2 : 4;
+  const uint32_t workgroupSize = 16;
+  Dims3 workgroupsCount = {
+    DivCeil(N, colWorkPerThread * workgroupSize),
+    DivCeil(M, rowWorkPerThread * workgroupSize),
+    NumElements(batchShape),
+  };
+
+  // Use split-K when there are only a few output tiles for a long reduction,
+  // the splits are dispatched as batches.
+  uint32_t outNumElements = M * N * NumElements(batchShape);
+  uint32_t splitSize = HasEpilogue(epilogue)
+      ? 0
+      : GetSplitSize(workgroupsCount.x * workgroupsCount.y * workgroupsCount.z,
+                     K);
+  uint32_t splitCount = splitSize > 0 ? DivCeil(K, splitSize) : 1;
+  Buffer partials;
+  if (splitCount > 1) {
+    partials = CreatePartialsBuffer(device, dataType, outNumElements,
+                                    splitCount);
+    workgroupsCount.z *= splitCount;
+  }
+
+  bool contiguous = batchShape.size() < 2;
+  std::vector<Buffer> buffers = {
+    splitCount > 1 ? partials : out,
+    a,
+    b,
+    device.CreateBufferFromScalar(M),
+    device.CreateBufferFromScalar(N),
+    device.CreateBufferFromScalar(K),
+    device.CreateBufferFromScalar(aLeadingStride),
+    device.CreateBufferFromScalar(bLeadingStride),
+    device.CreateBufferFromVector(
+        batchStridesA.empty() ? std::vector<uint32_t>{0} : batchStridesA),
+    device.CreateBufferFromVector(
+        batchStridesB.empty() ? std::vector<uint32_t>{0} : batchStridesB),
+    !contiguous ? device.CreateBufferFromVector(batchShape) : nullptr,
+  };
+  VariablesMap epilogueVariables = AddEpilogueBuffers(device, epilogue,
+                                                      buffers);
+  bool enableF16 = EnableF16(device, dataType);
+  auto capacities = GetCapacityVariables(device, enableF16, disableSubgroups);
+  RunKernel(device,
+            "gemm",
+            fmt::format("gemm_{}_{}_{}_{}_{}_{}_{}_{}_{}",
+                        aTranspose,
+                        bTranspose,
+                        contiguous,
+                        std::get<bool>(capacities["enable_subgroups"]),
+                        WgslType(dataType),
+                        rowWorkPerThread,
+                        colWorkPerThread,
+                        splitCount > 1 ? splitSize : 0,
+                        GetEpilogueKey(epilogue)),
+            [&]() {
+              VariablesMap variables = {
+                {"a_transposed", aTranspose},
+                {"b_transposed", bTranspose},
+                {"contiguous", contiguous},
+                {"dtype", WgslType(dataType)},
+                {"dtype_is_floating", IsFloating(dataType)},
+                {"row_work_per_thread", rowWorkPerThread},
+                {"col_work_per_thread", colWorkPerThread},
+                {"split_k", splitCount > 1},
+                {"split_size", splitSize},
+              };
+              return Append(
+                  ParseTemplate(wgsl_source_gemm, variables, capacities),
+                  ParseTemplate(wgsl_source_gemm_ops, variables, capacities),
+                  GetEpilogueSource(dataType, epilogue, epilogueVariables),
+                  wgsl_source_utils);
+            },
+            std::move(buffers),
+            workgroupsCount);
+  if (splitCount > 1) {
+    ReduceLast(device, ReduceType::Sum, dataType, out, outNumElements,
+               dataType, partials, splitCount, disableSubgroups);
+  }
 }
 
 void MatrixMultiply(Device& device,
@@ -142,12 +625,15 @@ void MatrixMultiply(Device& device,
                     const std::vector<uint32_t>& aStrides,
                     Buffer b,
                     const std::vector<uint32_t>& bShape,
-                    const std::vector<uint32_t>& bStrides) {
+                    const std::vector<uint32_t>& bStrides,
+                    const MatmulEpilogue& epilogue) {
   if (aShape.size() < 2 || bShape.size() < 2)
     throw std::runtime_error("Inputs of MatrixMultipy must be matrices.");
 
   // Return 0s if either input is empty.
   if (a.GetSize() == 0 || b.GetSize() == 0) {
+    if (HasEpilogue(epilogue))
+      throw std::runtime_error("Epilogue does not support empty inputs.");
     CopyContiguous(device, CopyType::Scalar,
                    dataType, out, out.GetSize() / SizeOf(dataType),
                    DataType::U32, device.CreateBufferFromScalar(0u));
@@ -157,27 +643,32 @@ void MatrixMultiply(Device& device,
   uint32_t M = aShape[aShape.size() - 2];
   uint32_t K = aShape[aShape.size() - 1];
   uint32_t N = bShape[bShape.size() - 1];
-  bool isMatrixVector = M == 1 || N == 1;
 
   // Check transpose state and do contiguous copies when necessary.
   auto [aTransposed, aNeedsCopy, aLeadingStride] =
       NeedsContiguousCopy(aShape, aStrides, M == 1);
   auto [bTransposed, bNeedsCopy, bLeadingStride] =
       NeedsContiguousCopy(bShape, bStrides, N == 1);
+  std::vector<uint32_t> aArrayStrides = aStrides;
+  std::vector<uint32_t> bArrayStrides = bStrides;
   if (aNeedsCopy)
-    a = CopyArray(device, dataType, a, aShape, aStrides);
+    a = CopyArray(device, dataType, a, aShape, aArrayStrides);
   if (bNeedsCopy)
-    b = CopyArray(device, dataType, b, bShape, bStrides);
+    b = CopyArray(device, dataType, b, bShape, bArrayStrides);
 
-  // Collapse batch dimensions.
+  // Broadcast batch dimensions and collapse them.
   std::vector<uint32_t> aBatchShape = Slice(aShape, 0, -2);
   std::vector<uint32_t> bBatchShape = Slice(bShape, 0, -2);
-  if (aBatchShape != bBatchShape)
-    throw std::runtime_error("Matrices have incorrectly broadcasted shapes.");
+  std::vector<uint32_t> outBatchShape = BroadcastShapes(aBatchShape,
+                                                        bBatchShape);
   auto [batchShape, aBatchStrides, bBatchStrides] =
-      CollapseContiguousDims(aBatchShape,
-                             Slice(aStrides, 0, -2),
-                             Slice(bStrides, 0, -2));
+      CollapseContiguousDims(outBatchShape,
+                             BroadcastStrides(outBatchShape,
+                                              aBatchShape,
+                                              Slice(aArrayStrides, 0, -2)),
+                             BroadcastStrides(outBatchShape,
+                                              bBatchShape,
+                                              Slice(bArrayStrides, 0, -2)));
   if (batchShape.empty()) {
     batchShape = {1};
     aBatchStrides = bBatchStrides = {0};
@@ -185,7 +676,8 @@ void MatrixMultiply(Device& device,
 
   // Collapse batches into M if possible.
   if (batchShape.size() == 1 &&
-      aStrides[aStrides.size() - 2] == K &&
+      !aTransposed &&
+      aLeadingStride == K &&
       aBatchStrides[aBatchStrides.size() - 1] == M * K &&
       bBatchStrides[bBatchStrides.size() - 1] == 0 &&
       NumElements(batchShape) > 1) {
@@ -195,25 +687,29 @@ void MatrixMultiply(Device& device,
     bBatchStrides = {0};
   }
 
-  if (isMatrixVector) {
+  if (M == 1 || N == 1) {
     bool bIsMatrix = N != 1;
-    MatrixVectorMultiply(device, dataType, batchShape, out,
-                         bIsMatrix ? b : a,
-                         bIsMatrix ? !bTransposed : aTransposed,
-                         bIsMatrix ? (bTransposed ? bShape[bShape.size() - 1]
-                                                  : bShape[bShape.size() - 2])
-                                   : (aTransposed ? aShape[aShape.size() - 1]
-                                                  : aShape[aShape.size() - 2]),
-                         bIsMatrix ? (bTransposed ? bShape[bShape.size() - 2]
-                                                  : bShape[bShape.size() - 1])
-                                   : (aTransposed ? aShape[aShape.size() - 2]
-                                                  : aShape[aShape.size() - 1]),
-                         bIsMatrix ? bLeadingStride : aLeadingStride,
-                         bIsMatrix ? bBatchStrides : aBatchStrides,
-                         bIsMatrix ? a: b,
-                         bIsMatrix ? aBatchStrides : bBatchStrides);
+    // When the output is a column vector the bias has only one element.
+    bool scalarBias = !bIsMatrix;
+    RunMatrixVectorMultiply(device, dataType, batchShape, out,
+                            bIsMatrix ? b : a,
+                            bIsMatrix ? !bTransposed : aTransposed,
+                            bIsMatrix ? (bTransposed ? N : K)
+                                      : (aTransposed ? K : M),
+                            bIsMatrix ? (bTransposed ? K : N)
+                                      : (aTransposed ? M : K),
+                            bIsMatrix ? bLeadingStride : aLeadingStride,
+                            bIsMatrix ? bBatchStrides : aBatchStrides,
+                            bIsMatrix ? a: b,
+                            bIsMatrix ? aBatchStrides : bBatchStrides,
+                            false,
+                            epilogue,
+                            scalarBias);
   } else {
-    throw std::runtime_error("gemm kernel has not been implemented.");
+    GeneralMatrixMultiply(device, dataType, batchShape, out, M, N, K,
+                          a, aTransposed, aLeadingStride, aBatchStrides,
+                          b, bTransposed, bLeadingStride, bBatchStrides,
+                          false, epilogue);
   }
 }
 
@@ -1,10 +1,11 @@
 #ifndef BETANN_MATMUL_H_
 #define BETANN_MATMUL_H_
 
-#include "betann/device.h"
+#include "betann/kernels.h"
 
 namespace betann {
 
+// Multiply matrix by vector in batches.
 void MatrixVectorMultiply(Device& device,
                           DataType dataType,
                           const std::vector<uint32_t>& batchShape,
@@ -17,7 +18,66 @@ void MatrixVectorMultiply(Device& device,
                           const std::vector<uint32_t>& batchStridesMat,
                           const Buffer& vec,
                           const std::vector<uint32_t>& batchStridesVec,
-                          bool disableSubgroups = false);
+                          bool disableSubgroups = false,
+                          const MatmulEpilogue& epilogue = {});
+
+// Multiply the contiguous vectors in batch by an affine quantized matrix, whose
+// elements are dequantized as (scale * q + bias).
+// Each row of the matrix is packed as a little-endian bitstream of u32 words,
+// and each |groupSize| elements of a row share the same scale and bias, which
+// are stored in |scales| and |biases| with shape [matRows, matCols / groupSize].
+void QuantizedMatrixVectorMultiply(Device& device,
+                                   DataType dataType,
+                                   uint32_t batchSize,
+                                   const Buffer& out,
+                                   const Buffer& mat,
+                                   bool matTranspose,
+                                   uint32_t matRows,
+                                   uint32_t matCols,
+                                   const Buffer& scales,
+                                   const Buffer& biases,
+                                   uint32_t groupSize,
+                                   uint32_t bits,
+                                   const Buffer& vec,
+                                   bool disableSubgroups = false);
+
+// Multiply the contiguous matrix |x| by an affine quantized matrix, which has
+// the same layout with QuantizedMatrixVectorMultiply. When |matTranspose| is
+// false the output is (x @ mat.T) and |x| has |matCols| columns, otherwise the
+// output is (x @ mat) and |x| has |matRows| columns.
+void QuantizedMatrixMultiply(Device& device,
+                             DataType dataType,
+                             const Buffer& out,
+                             uint32_t M,
+                             const Buffer& x,
+                             const Buffer& mat,
+                             bool matTranspose,
+                             uint32_t matRows,
+                             uint32_t matCols,
+                             const Buffer& scales,
+                             const Buffer& biases,
+                             uint32_t groupSize,
+                             uint32_t bits,
+                             bool disableSubgroups = false);
+
+// Multiply matrices in batches with tiled kernel, the output is contiguous.
+void GeneralMatrixMultiply(Device& device,
+                           DataType dataType,
+                           const std::vector<uint32_t>& batchShape,
+                           const Buffer& out,
+                           uint32_t M,
+                           uint32_t N,
+                           uint32_t K,
+                           const Buffer& a,
+                           bool aTranspose,
+                           uint32_t aLeadingStride,
+                           const std::vector<uint32_t>& batchStridesA,
+                           const Buffer& b,
+                           bool bTranspose,
+                           uint32_t bLeadingStride,
+                           const std::vector<uint32_t>& batchStridesB,
+                           bool disableSubgroups = false,
+                           const MatmulEpilogue& epilogue = {});
 
 }  // namespace betann
 
@@ -0,0 +1,143 @@
+#include "betann/prepared_op.h"
+
+#include <fmt/format.h>
+
+#include "betann/reduce.h"
+
+namespace betann {
+
+namespace {
+
+// Capture the commands issued by |record| into a PreparedOp.
+template<typename F>
+PreparedOp Prepare(Device& device,
+                   std::vector<Buffer> inputs,
+                   std::vector<Buffer> outputs,
+                   F&& record) {
+  std::set<WGPUBuffer> buffers;
+  for (const auto* list : {&inputs, &outputs}) {
+    for (const Buffer& buffer : *list) {
+      if (!buffers.insert(buffer.data.Get()).second)
+        throw std::runtime_error("Buffers of a prepared op must be distinct.");
+    }
+  }
+  device.BeginCapture();
+  try {
+    record();
+  } catch (...) {
+    device.EndCapture();
+    throw;
+  }
+  return PreparedOp(device,
+                    device.EndCapture(),
+                    std::move(inputs),
+                    std::move(outputs));
+}
+
+}  // namespace
+
+PreparedOp::PreparedOp(Device& device,
+                       CommandGraph graph,
+                       std::vector<Buffer> inputs,
+                       std::vector<Buffer> outputs)
+    : device_(&device),
+      graph_(std::move(graph)),
+      numInputs_(inputs.size()),
+      numOutputs_(outputs.size()) {
+  std::vector<Buffer> bindings = std::move(inputs);
+  bindings.insert(bindings.end(), outputs.begin(), outputs.end());
+  graph_.DeclareBindings(std::move(bindings));
+}
+
+void PreparedOp::Run(const std::vector<Buffer>& inputs,
+                     const std::vector<Buffer>& outputs) {
+  if (inputs.size() != numInputs_ || outputs.size() != numOutputs_) {
+    throw std::runtime_error(
+        fmt::format("The prepared op expects {} inputs and {} outputs.",
+                    numInputs_, numOutputs_));
+  }
+  std::vector<Buffer> bindings = inputs;
+  bindings.insert(bindings.end(), outputs.begin(), outputs.end());
+  device_->Replay(graph_, bindings);
+}
+
+PreparedOp PrepareBinaryOpGeneral(Device& device,
+                                  const char* name,
+                                  DataType outputDataType,
+                                  const Buffer& output,
+                                  const std::vector<uint32_t>& shape,
+                                  DataType inputDataType,
+                                  const Buffer& a,
+                                  const std::vector<uint32_t>& aStrides,
+                                  const Buffer& b,
+                                  const std::vector<uint32_t>& bStrides) {
+  return Prepare(device, {a, b}, {output}, [&]() {
+    BinaryOpGeneral(device, name, outputDataType, output, shape,
+                    inputDataType, a, aStrides, b, bStrides);
+  });
+}
+
+PreparedOp PrepareCopyGeneral(Device& device,
+                              DataType dstDataType,
+                              const Buffer& dst,
+                              DataType srcDataType,
+                              const Buffer& src,
+                              const std::vector<uint32_t>& srcShape,
+                              const std::vector<uint32_t>& srcStrides) {
+  return Prepare(device, {src}, {dst}, [&]() {
+    CopyGeneral(device, dstDataType, dst, srcDataType, src,
+                srcShape, srcStrides);
+  });
+}
+
+PreparedOp PrepareUnaryOpGeneral(Device& device,
+                                 const char* name,
+                                 DataType outputDataType,
+                                 const Buffer& output,
+                                 DataType inputDataType,
+                                 const Buffer& input,
+                                 const std::vector<uint32_t>& inputShape,
+                                 const std::vector<uint32_t>& inputStrides) {
+  return Prepare(device, {input}, {output}, [&]() {
+    UnaryOpGeneral(device, name, outputDataType, output, inputDataType, input,
+                   inputShape, inputStrides);
+  });
+}
+
+PreparedOp PrepareReduceRow(Device& device,
+                            ReduceType type,
+                            DataType outputDataType,
+                            const Buffer& output,
+                            uint32_t outputNumElements,
+                            DataType inputDataType,
+                            const Buffer& input,
+                            const std::vector<uint32_t>& inputShape,
+                            const std::vector<uint32_t>& inputStrides,
+                            const std::vector<uint32_t>& reductionAxes,
+                            std::vector<uint32_t> reductionShape,
+                            std::vector<uint32_t> reductionStrides,
+                            bool disableSubgroups) {
+  return Prepare(device, {input}, {output}, [&]() {
+    ReduceRow(device, type, outputDataType, output, outputNumElements,
+              inputDataType, input, inputShape, inputStrides, reductionAxes,
+              std::move(reductionShape), std::move(reductionStrides),
+              disableSubgroups);
+  });
+}
+
+PreparedOp PrepareMatrixMultiply(Device& device,
+                                 DataType dataType,
+                                 const Buffer& out,
+                                 const Buffer& a,
+                                 const std::vector<uint32_t>& aShape,
+                                 const std::vector<uint32_t>& aStrides,
+                                 const Buffer& b,
+                                 const std::vector<uint32_t>& bShape,
+                                 const std::vector<uint32_t>& bStrides) {
+  return Prepare(device, {a, b}, {out}, [&]() {
+    MatrixMultiply(device, dataType, out, a, aShape, aStrides,
+                   b, bShape, bStrides);
+  });
+}
+
+}  // namespace betann
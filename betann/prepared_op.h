@@ -0,0 +1,90 @@
+#ifndef BETANN_PREPARED_OP_H_
+#define BETANN_PREPARED_OP_H_
+
+#include "betann/kernels.h"
+
+namespace betann {
+
+// An op whose pipelines, parameter buffers and dispatch dimensions have been
+// resolved, which can be run repeatedly with different inputs and outputs of
+// the same shapes.
+class PreparedOp {
+ public:
+  PreparedOp(Device& device,
+             CommandGraph graph,
+             std::vector<Buffer> inputs,
+             std::vector<Buffer> outputs);
+
+  // Encode the op with |inputs| and |outputs|, which must be in the same order
+  // as the buffers passed when preparing.
+  void Run(const std::vector<Buffer>& inputs,
+           const std::vector<Buffer>& outputs);
+
+  size_t GetCommandCount() const { return graph_.GetCommandCount(); }
+
+ private:
+  Device* device_;
+  CommandGraph graph_;
+  size_t numInputs_;
+  size_t numOutputs_;
+};
+
+// The Prepare* functions take the same arguments as the ops, but instead of
+// running the op they record it for later runs. The buffers are only used for
+// resolving the op and must be distinct from each other.
+
+PreparedOp PrepareBinaryOpGeneral(Device& device,
+                                  const char* name,
+                                  DataType outputDataType,
+                                  const Buffer& output,
+                                  const std::vector<uint32_t>& shape,
+                                  DataType inputDataType,
+                                  const Buffer& a,
+                                  const std::vector<uint32_t>& aStrides,
+                                  const Buffer& b,
+                                  const std::vector<uint32_t>& bStrides);
+
+PreparedOp PrepareCopyGeneral(Device& device,
+                              DataType dstDataType,
+                              const Buffer& dst,
+                              DataType srcDataType,
+                              const Buffer& src,
+                              const std::vector<uint32_t>& srcShape,
+                              const std::vector<uint32_t>& srcStrides);
+
+PreparedOp PrepareUnaryOpGeneral(Device& device,
+                                 const char* name,
+                                 DataType outputDataType,
+                                 const Buffer& output,
+                                 DataType inputDataType,
+                                 const Buffer& input,
+                                 const std::vector<uint32_t>& inputShape,
+                                 const std::vector<uint32_t>& inputStrides);
+
+PreparedOp PrepareReduceRow(Device& device,
+                            ReduceType type,
+                            DataType outputDataType,
+                            const Buffer& output,
+                            uint32_t outputNumElements,
+                            DataType inputDataType,
+                            const Buffer& input,
+                            const std::vector<uint32_t>& inputShape,
+                            const std::vector<uint32_t>& inputStrides,
+                            const std::vector<uint32_t>& reductionAxes,
+                            std::vector<uint32_t> reductionShape,
+                            std::vector<uint32_t> reductionStrides,
+                            bool disableSubgroups = false);
+
+PreparedOp PrepareMatrixMultiply(Device& device,
+                                 DataType dataType,
+                                 const Buffer& out,
+                                 const Buffer& a,
+                                 const std::vector<uint32_t>& aShape,
+                                 const std::vector<uint32_t>& aStrides,
+                                 const Buffer& b,
+                                 const std::vector<uint32_t>& bShape,
+                                 const std::vector<uint32_t>& bStrides);
+
+}  // namespace betann
+
+#endif  // BETANN_PREPARED_OP_H_
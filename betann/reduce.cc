@@ -1,5 +1,7 @@
 #include "betann/reduce.h"
 
+#include <algorithm>
+
 #include <fmt/format.h>
 
 #include "betann/kernels_helper.h"
@@ -23,7 +25,104 @@ const char* ReduceTypeToString(ReduceType type, DataType dataType) {
       return dataType == DataType::Bool ? "and" : "min";
     case ReduceType::Max:
       return dataType == DataType::Bool ? "and" : "max";
+    case ReduceType::ArgMin:
+      return "argmin";
+    case ReduceType::ArgMax:
+      return "argmax";
+    case ReduceType::MeanVariance:
+      return "meanvar";
+    case ReduceType::LogSumExp:
+      return "logsumexp";
+  }
+}
+
+bool IsArgReduce(ReduceType type) {
+  return type == ReduceType::ArgMin || type == ReduceType::ArgMax;
+}
+
+// Whether the reduction carries more states than the output, whose partial
+// results can not be reduced again.
+bool HasStructTotal(ReduceType type) {
+  return IsArgReduce(type) ||
+         type == ReduceType::MeanVariance ||
+         type == ReduceType::LogSumExp;
+}
+
+void CheckReduceOutputs(ReduceType type,
+                        DataType outputDataType,
+                        const Buffer& outputValues) {
+  if (IsArgReduce(type)) {
+    if (outputDataType != DataType::U32 && outputDataType != DataType::I32)
+      throw std::runtime_error("The output of arg reduce must be integers.");
+  } else if (type == ReduceType::MeanVariance) {
+    if (!IsFloating(outputDataType))
+      throw std::runtime_error("The output of mean must be floating points.");
+  } else if (type == ReduceType::LogSumExp) {
+    if (!IsFloating(outputDataType))
+      throw std::runtime_error(
+          "The output of logsumexp must be floating points.");
   }
+  if (outputValues && !IsArgReduce(type) && type != ReduceType::MeanVariance) {
+    throw std::runtime_error(
+        "Only arg reduce and mean/variance can write values.");
+  }
+}
+
+bool HasPrologue(const ReducePrologue& prologue) {
+  return prologue.binaryOp || prologue.unaryOp;
+}
+
+void CheckReducePrologue(ReduceType type, const ReducePrologue& prologue) {
+  if (IsArgReduce(type) && HasPrologue(prologue))
+    throw std::runtime_error("Arg reduce does not support prologue ops.");
+  if (!prologue.binaryOp != !prologue.other)
+    throw std::runtime_error(
+        "The binary op of prologue must be set with other input.");
+}
+
+std::string GetPrologueKey(const ReducePrologue& prologue) {
+  if (!HasPrologue(prologue))
+    return "none";
+  return fmt::format("{}_{}",
+                     prologue.binaryOp ? prologue.binaryOp : "none",
+                     prologue.unaryOp ? prologue.unaryOp : "none");
+}
+
+// Append the buffer used by |prologue| to |buffers|, and set its binding in
+// |capacities|.
+void AddPrologueBuffers(const ReducePrologue& prologue,
+                        std::vector<Buffer>& buffers,
+                        VariablesMap& capacities) {
+  if (!prologue.other)
+    return;
+  // The bindings are assigned sequentially to the non-null buffers.
+  capacities["other_binding"] = static_cast<uint32_t>(
+      std::count_if(buffers.begin(), buffers.end(),
+                    [](const Buffer& b) { return !!b; }));
+  buffers.push_back(prologue.other);
+}
+
+// Whether the elements of input fill the memory without gaps, and when
+// |rowMajor| is true they must also be stored in the order of dims.
+bool IsDense(const std::vector<uint32_t>& shape,
+             const std::vector<uint32_t>& strides,
+             bool rowMajor) {
+  std::vector<std::pair<uint32_t, uint32_t>> dims;
+  for (size_t i = 0; i < shape.size(); ++i) {
+    if (shape[i] > 1)
+      dims.emplace_back(shape[i], strides[i]);
+  }
+  if (!rowMajor) {
+    std::sort(dims.begin(), dims.end(),
+              [](const auto& a, const auto& b) { return a.second > b.second; });
+  }
+  uint32_t size = 1;
+  for (auto it = dims.rbegin(); it != dims.rend(); ++it) {
+    if (it->second != size)
+      return false;
+    size *= it->first;
+  }
+  return true;
 }
 
 uint32_t RowThreadsForRowSize(uint32_t rowSize) {
@@ -35,14 +134,34 @@ uint32_t RowThreadsForRowSize(uint32_t rowSize) {
     return 256;
 }
 
+// When there are too few outputs for long rows, split each row among more
+// workgroups and reduce the partial results in a second pass.
+uint32_t GetRowSplitCount(ReduceType type,
+                          uint32_t outputNumElements,
+                          uint32_t rowSize) {
+  const uint32_t targetWorkgroupsCount = 128;
+  const uint32_t minSplitSize = 4096;
+  if (HasStructTotal(type) ||
+      outputNumElements * 2 > targetWorkgroupsCount ||
+      rowSize < 2 * minSplitSize) {
+    return 1;
+  }
+  return std::min(DivCeil(targetWorkgroupsCount, outputNumElements),
+                  DivCeil(rowSize, minSplitSize));
+}
+
 std::string GetReduceShaderCode(const char* source,
                                 const char* op,
                                 const VariablesMap& capacities,
                                 DataType outputDataType,
                                 DataType inputDataType,
                                 uint32_t workgroupSize,
-                                bool useReduceUtilies = true) {
-  return Append(
+                                bool useReduceUtilies = true,
+                                const ReducePrologue& prologue = {}) {
+  bool argReduce = std::string_view(op).substr(0, 3) == "arg";
+  bool welfordReduce = std::string_view(op) == "meanvar";
+  bool logSumExpReduce = std::string_view(op) == "logsumexp";
+  std::string code = Append(
       ParseTemplate(
           source,
           {
@@ -50,6 +169,10 @@ std::string GetReduceShaderCode(const char* source,
             {"output_dtype", WgslType(outputDataType)},
             {"input_dtype", WgslType(inputDataType)},
             {"workgroup_size", workgroupSize},
+            {"arg_reduce", argReduce},
+            {"welford_reduce", welfordReduce},
+            {"logsumexp_reduce", logSumExpReduce},
+            {"struct_total", argReduce || welfordReduce || logSumExpReduce},
           },
           capacities),
       ParseTemplate(
@@ -63,13 +186,116 @@ std::string GetReduceShaderCode(const char* source,
           {
             {"op", op},
             {"output_dtype", WgslType(outputDataType)},
+            {"input_dtype", WgslType(inputDataType)},
+            {"arg_reduce", argReduce},
+            {"welford_reduce", welfordReduce},
+            {"logsumexp_reduce", logSumExpReduce},
+            {"struct_total", argReduce || welfordReduce || logSumExpReduce},
             {"use_reduce_utilities", useReduceUtilies},
+            {"has_prologue", HasPrologue(prologue)},
+            {"has_binary_op", prologue.binaryOp != nullptr},
+            {"binary_op", prologue.binaryOp ? prologue.binaryOp : ""},
+            {"has_unary_op", prologue.unaryOp != nullptr},
+            {"unary_op", prologue.unaryOp ? prologue.unaryOp : ""},
           },
           capacities));
+  if (prologue.binaryOp) {
+    code += ParseTemplate(
+        wgsl_source_binary_ops,
+        {
+          {"input_is_floating", IsFloating(inputDataType)},
+          {"input_is_integer", IsInteger(inputDataType)},
+        });
+  }
+  if (prologue.unaryOp) {
+    code += ParseTemplate(
+        wgsl_source_unary_ops,
+        {
+          {"input_is_bool", inputDataType == DataType::Bool},
+          {"input_is_floating", IsFloating(inputDataType)},
+          {"input_is_unsigned", IsUnsigned(inputDataType)},
+        });
+  }
+  return code;
 }
 
 }  // namespace
 
+ReductionPlan GetReductionPlan(const std::vector<uint32_t>& shape,
+                               const std::vector<uint32_t>& strides,
+                               const std::vector<uint32_t>& axes,
+                               bool keepOrder) {
+  // Reduce all elements of contiguous input.
+  if (axes.size() == shape.size() && IsDense(shape, strides, keepOrder))
+    return {ReductionPlanType::ReduceAll, {}, {}};
+
+  // Sort the reduction dims by strides, with the broadcasted ones first, so
+  // the contiguous dims are neighbors.
+  std::vector<std::pair<uint32_t, uint32_t>> reductions;
+  for (uint32_t axis : axes) {
+    if (shape[axis] > 1)
+      reductions.emplace_back(shape[axis], strides[axis]);
+  }
+  if (!keepOrder) {
+    std::stable_sort(reductions.begin(), reductions.end(),
+                     [](const auto& a, const auto& b) {
+                       if ((a.second == 0) != (b.second == 0))
+                         return a.second < b.second;
+                       return a.second > b.second;
+                     });
+  }
+  // Collapse the contiguous dims.
+  for (size_t i = reductions.size(); i > 1; --i) {
+    auto [innerSize, innerStride] = reductions[i - 1];
+    auto [outerSize, outerStride] = reductions[i - 2];
+    if (outerStride == innerSize * innerStride) {
+      reductions[i - 2] = {outerSize * innerSize, innerStride};
+      reductions.erase(reductions.begin() + i - 1);
+    }
+  }
+  // All reduction dims have size 1.
+  if (reductions.empty())
+    return {ReductionPlanType::ReduceRow, {1}, {1}};
+
+  ReductionPlan plan{ReductionPlanType::ReduceGeneral, {}, {}};
+  for (auto [size, stride] : reductions) {
+    plan.reductionShape.push_back(size);
+    plan.reductionStrides.push_back(stride);
+  }
+  uint32_t rowStride = plan.reductionStrides.back();
+  if (rowStride == 1) {
+    plan.type = ReductionPlanType::ReduceRow;
+    return plan;
+  }
+  // Read columns when the non-reduction dims after the innermost reduction
+  // are contiguous. With broadcasted dims it is unknown whether they come
+  // before or after the reduction, so require the contiguous size to cover
+  // the reduction stride.
+  if (rowStride > 1) {
+    std::vector<bool> isReduction(shape.size(), false);
+    for (uint32_t axis : axes)
+      isReduction[axis] = true;
+    uint32_t size = 1;
+    bool hasBroadcast = false;
+    for (int32_t i = shape.size() - 1; i >= 0; --i) {
+      if (isReduction[i])
+        continue;
+      if (strides[i] == 0) {
+        if (shape[i] == 1)
+          continue;
+        hasBroadcast = true;
+        break;
+      }
+      if (strides[i] != size && shape[i] != 1)
+        break;
+      size *= shape[i];
+    }
+    if (size > rowStride || (size == rowStride && !hasBroadcast))
+      plan.type = ReductionPlanType::ReduceCol;
+  }
+  return plan;
+}
+
 void ReduceAll(Device& device,
                ReduceType type,
                DataType outputDataType,
@@ -77,35 +303,58 @@ void ReduceAll(Device& device,
                DataType inputDataType,
                const Buffer& input,
                uint32_t inputNumElements,
-               bool disableSubgroups) {
+               bool disableSubgroups,
+               const Buffer& outputValues,
+               const ReducePrologue& prologue) {
+  CheckReduceOutputs(type, outputDataType, outputValues);
+  CheckReducePrologue(type, prologue);
   // Kernel creation helper.
-  auto runKernel = [&](DataType outputDataType,
-                       const Buffer& output,
-                       DataType inputDataType,
+  auto runKernel = [&](const Buffer& output,
                        const Buffer& input,
                        uint32_t workgroupSize,
                        uint32_t rowSize,
-                       uint32_t numRows) {
+                       uint32_t numRows,
+                       bool writePartials,
+                       bool readPartials) {
     const char* op = ReduceTypeToString(type, outputDataType);
     bool enableF16 = EnableF16(device, outputDataType, inputDataType);
     auto capacities = GetCapacityVariables(device, enableF16, disableSubgroups);
+    capacities["write_partials"] = writePartials;
+    capacities["read_partials"] = readPartials;
+    capacities["write_values"] = !writePartials && bool(outputValues);
+    std::vector<Buffer> buffers = {
+      output,
+      input,
+      device.CreateBufferFromScalar(rowSize),
+      writePartials ? Buffer() : outputValues,
+    };
+    // The prologue is applied when reading input in the 1st pass.
+    const ReducePrologue& passPrologue =
+        readPartials ? ReducePrologue() : prologue;
+    AddPrologueBuffers(passPrologue, buffers, capacities);
     RunKernel(device,
               fmt::format("reduce_all_{}", op),
-              fmt::format("reduce_all_{}_{}_{}_{}_{}",
+              fmt::format("reduce_all_{}_{}_{}_{}_{}_{}_{}_{}_{}",
                           op,
                           std::get<bool>(capacities["enable_subgroups"]),
                           workgroupSize,
                           WgslType(outputDataType),
-                          WgslType(inputDataType)),
+                          WgslType(inputDataType),
+                          writePartials,
+                          readPartials,
+                          std::get<bool>(capacities["write_values"]),
+                          GetPrologueKey(passPrologue)),
               [&]() {
                 return GetReduceShaderCode(wgsl_source_reduce_all,
                                            op,
                                            capacities,
                                            outputDataType,
                                            inputDataType,
-                                           workgroupSize);
+                                           workgroupSize,
+                                           true,
+                                           passPrologue);
               },
-              {output, input, device.CreateBufferFromScalar(rowSize)},
+              std::move(buffers),
               {1, numRows, 1});
   };
 
@@ -114,10 +363,13 @@ void ReduceAll(Device& device,
   if (inputNumElements <= workPerThread * 1024) {
     // Small input use a single workgroup.
     uint32_t workgroupSize = 64;  // TODO(zcbenz): make it dynamic
-    runKernel(outputDataType, output, inputDataType, input,
-              workgroupSize, inputNumElements, 1);
+    runKernel(output, input, workgroupSize, inputNumElements, 1, false, false);
   } else {
-    // Do reduction in 2 passes.
+    // Do reduction in 2 passes, the 1st pass writes the partial result of each
+    // row and the 2nd pass reduces them. It can not be done in one dispatch:
+    // WGSL does not order memory accesses between workgroups, so neither the
+    // partial results written by other workgroups nor an output initialized
+    // for atomics by one of them is guaranteed to be seen.
     uint32_t numRows, workgroupSize2ndPass;
     if (inputNumElements * SizeOf(inputDataType) <= (1 << 26)) {
       numRows = workPerThread * 32;
@@ -126,16 +378,18 @@ void ReduceAll(Device& device,
       numRows = workPerThread * 1024;
       workgroupSize2ndPass = 1024;
     }
-    // 1st pass.
     uint32_t rowSize = DivCeil(inputNumElements, numRows);
+    numRows = DivCeil(inputNumElements, rowSize);
     uint32_t workgroupSize = 256;
-    Buffer intermediate = device.CreateBuffer(numRows * SizeOf(outputDataType),
-                                              BufferUsage::Storage);
-    runKernel(outputDataType, intermediate, inputDataType, input,
-              workgroupSize, rowSize, numRows);
-    // 2nd pass.
-    runKernel(outputDataType, output, outputDataType, intermediate,
-              workgroupSize2ndPass, numRows, 1);
+    // Each partial result takes at most 16 bytes.
+    Buffer partials;
+    {
+      Device::MemoryScope intermediateScope(device,
+                                            MemoryCategory::Intermediates);
+      partials = device.CreateBuffer(numRows * 16, BufferUsage::Storage);
+    }
+    runKernel(partials, input, workgroupSize, rowSize, numRows, true, false);
+    runKernel(output, partials, workgroupSize2ndPass, numRows, 1, false, true);
   }
 }
 
@@ -147,36 +401,81 @@ void ReduceLast(Device& device,
                 DataType inputDataType,
                 const Buffer& input,
                 uint32_t rowSize,
-                bool disableSubgroups) {
+                bool disableSubgroups,
+                const Buffer& outputValues,
+                const ReducePrologue& prologue) {
+  CheckReduceOutputs(type, outputDataType, outputValues);
+  CheckReducePrologue(type, prologue);
+  if (GetRowSplitCount(type, outputNumElements, rowSize) > 1) {
+    // Use ReduceRow for splitting few long rows.
+    return ReduceRow(device, type,
+                     outputDataType, output, outputNumElements,
+                     inputDataType, input,
+                     {outputNumElements, rowSize}, {rowSize, 1}, {1},
+                     {rowSize}, {1},
+                     disableSubgroups, outputValues, prologue);
+  }
   const char* op = ReduceTypeToString(type, outputDataType);
   bool enableF16 = EnableF16(device, outputDataType, inputDataType);
   auto capacities = GetCapacityVariables(device, enableF16, disableSubgroups);
+  capacities["write_values"] = bool(outputValues);
 
+  const uint32_t readPerThread = 4;
   const uint32_t writePerThread = 4;
-  const uint32_t workgroupSize = RowThreadsForRowSize(rowSize);
+  uint32_t workgroupSize;
+  uint32_t rowThreads = 0;
+  Dims3 workgroupCount;
+  if (rowSize <= 128) {
+    // Short rows would leave most threads idle, pack multiple rows in each
+    // workgroup and use only enough threads to read a row once.
+    workgroupSize = 256;
+    rowThreads = 1;
+    while (rowThreads * readPerThread < rowSize)
+      rowThreads *= 2;
+    uint32_t numWorkgroups =
+        DivCeil(outputNumElements, workgroupSize / rowThreads);
+    uint32_t maxWorkgroups = device.GetLimits().maxComputeWorkgroupsPerDimension;
+    workgroupCount.x = std::min(numWorkgroups, maxWorkgroups);
+    workgroupCount.y = DivCeil(numWorkgroups, maxWorkgroups);
+  } else {
+    workgroupSize = RowThreadsForRowSize(rowSize);
+    workgroupCount.y = DivCeil(outputNumElements, writePerThread);
+  }
+  capacities["packed"] = rowThreads > 0;
+  capacities["row_threads"] = rowThreads;
+
+  std::vector<Buffer> buffers = {
+    output,
+    device.CreateBufferFromScalar(outputNumElements),
+    input,
+    device.CreateBufferFromScalar(rowSize),
+    outputValues,
+  };
+  AddPrologueBuffers(prologue, buffers, capacities);
   RunKernel(device,
-            fmt::format("reduce_last_{}", op),
-            fmt::format("reduce_last_{}_{}_{}_{}_{}",
+            rowThreads > 0 ? fmt::format("reduce_last_packed_{}", op)
+                           : fmt::format("reduce_last_{}", op),
+            fmt::format("reduce_last_{}_{}_{}_{}_{}_{}_{}_{}",
                         op,
                         std::get<bool>(capacities["enable_subgroups"]),
                         workgroupSize,
+                        rowThreads,
                         WgslType(outputDataType),
-                        WgslType(inputDataType)),
+                        WgslType(inputDataType),
+                        bool(outputValues),
+                        GetPrologueKey(prologue)),
             [&]() {
               return GetReduceShaderCode(wgsl_source_reduce_last,
                                          op,
                                          capacities,
                                          outputDataType,
                                          inputDataType,
-                                         workgroupSize);
+                                         workgroupSize,
+                                         true,
+                                         prologue);
             },
-            {
-              output,
-              device.CreateBufferFromScalar(outputNumElements),
-              input,
-              device.CreateBufferFromScalar(rowSize),
-            },
-            {1, DivCeil(outputNumElements, writePerThread), 1});
+            std::move(buffers),
+            workgroupCount);
 }
 
 void ReduceRow(Device& device,
@@ -191,11 +490,14 @@ void ReduceRow(Device& device,
                const std::vector<uint32_t>& reductionAxes,
                std::vector<uint32_t> reductionShape,
                std::vector<uint32_t> reductionStrides,
-               bool disableSubgroups) {
-  if (reductionStrides.back() != 1)
-    throw std::runtime_error("The reducted row must be contiguous.");
+               bool disableSubgroups,
+               const Buffer& outputValues,
+               const ReducePrologue& prologue) {
+  CheckReduceOutputs(type, outputDataType, outputValues);
+  CheckReducePrologue(type, prologue);
   // The info used for reading rows.
   uint32_t rowSize = reductionShape.back();
+  uint32_t rowStride = reductionStrides.back();
   reductionShape.pop_back();
   reductionStrides.pop_back();
   uint32_t nonRowReductions = NumElements(reductionShape);
@@ -223,10 +525,14 @@ void ReduceRow(Device& device,
       device.GetAdapterInfo().backendType != wgpu::BackendType::D3D11 &&
       device.GetAdapterInfo().backendType != wgpu::BackendType::D3D12;
   capacities["use_fast_index"] = useFastIndex;
+  capacities["row_contiguous"] = rowStride == 1;
+  capacities["write_values"] = bool(outputValues);
+  capacities["values_binding"] = rowStride == 1 ? 9u : 10u;
 
   const char* entry;
   uint32_t workgroupSize;
   Dims3 workgroupCount;
+  uint32_t splitCount = 1;
   if (rowSize <= 64) {
     entry = "reduce_row_1d";
     workgroupSize = 128;  // TODO(zcbenz): make it dynamic
@@ -234,48 +540,208 @@ void ReduceRow(Device& device,
   } else {
     entry = "reduce_row_2d";
     workgroupSize = RowThreadsForRowSize(rowSize);
+    splitCount = GetRowSplitCount(type, outputNumElements, rowSize);
+    workgroupCount.x = splitCount;
     workgroupCount.y = outputNumElements;
   }
+  // The partial results are written as [output][split].
+  Buffer partials;
+  if (splitCount > 1) {
+    Device::MemoryScope intermediateScope(device,
+                                          MemoryCategory::Intermediates);
+    partials = device.CreateBuffer(
+        outputNumElements * splitCount * SizeOf(outputDataType),
+        BufferUsage::Storage);
+  }
 
   // Kernel dispatch.
+  std::vector<Buffer> buffers = {
+    splitCount > 1 ? partials : output,
+    device.CreateBufferFromScalar(outputNumElements),
+    input,
+    device.CreateBufferFromScalar(rowSize),
+    device.CreateBufferFromScalar(nonRowReductions),
+    nonReductionShape.empty()
+        ? device.CreateBufferFromScalar(0u)
+        : device.CreateBufferFromVector(nonReductionShape),
+    nonReductionStrides.empty()
+        ? device.CreateBufferFromScalar(0u)
+        : device.CreateBufferFromVector(nonReductionStrides),
+    reductionShape.empty()
+        ? device.CreateBufferFromScalar(0u)
+        : device.CreateBufferFromVector(reductionShape),
+    reductionStrides.empty()
+        ? device.CreateBufferFromScalar(0u)
+        : device.CreateBufferFromVector(reductionStrides),
+    rowStride == 1 ? Buffer() : device.CreateBufferFromScalar(rowStride),
+    outputValues,
+  };
+  AddPrologueBuffers(prologue, buffers, capacities);
   RunKernel(device,
             fmt::format("{}_{}", entry, op),
-            fmt::format("reduce_row_{}_{}_{}_{}_{}_{}",
+            fmt::format("reduce_row_{}_{}_{}_{}_{}_{}_{}_{}_{}",
                         op,
                         std::get<bool>(capacities["enable_subgroups"]),
                         workgroupSize,
                         coordCacheSize,
+                        rowStride == 1,
+                        bool(outputValues),
                         WgslType(outputDataType),
-                        WgslType(inputDataType)),
+                        WgslType(inputDataType),
+                        GetPrologueKey(prologue)),
             [&]() {
               return Append(GetReduceShaderCode(wgsl_source_reduce_row,
                                                 op,
                                                 capacities,
                                                 outputDataType,
                                                 inputDataType,
-                                                workgroupSize),
+                                                workgroupSize,
+                                                true,
+                                                prologue),
                             wgsl_source_utils);
             },
-            {
-              output,
-              device.CreateBufferFromScalar(outputNumElements),
-              input,
-              device.CreateBufferFromScalar(rowSize),
-              device.CreateBufferFromScalar(nonRowReductions),
-              nonReductionShape.empty()
-                  ? device.CreateBufferFromScalar(0u)
-                  : device.CreateBufferFromVector(nonReductionShape),
-              nonReductionStrides.empty()
-                  ? device.CreateBufferFromScalar(0u)
-                  : device.CreateBufferFromVector(nonReductionStrides),
-              reductionShape.empty()
-                  ? device.CreateBufferFromScalar(0u)
-                  : device.CreateBufferFromVector(reductionShape),
-              reductionStrides.empty()
-                  ? device.CreateBufferFromScalar(0u)
-                  : device.CreateBufferFromVector(reductionStrides),
-            },
+            std::move(buffers),
             workgroupCount);
+  if (splitCount > 1) {
+    ReduceLast(device, type, outputDataType, output, outputNumElements,
+               outputDataType, partials, splitCount, disableSubgroups);
+  }
+}
+
+void ReduceGeneral(Device& device,
+                   ReduceType type,
+                   DataType outputDataType,
+                   const Buffer& output,
+                   uint32_t outputNumElements,
+                   DataType inputDataType,
+                   const Buffer& input,
+                   const std::vector<uint32_t>& inputShape,
+                   const std::vector<uint32_t>& inputStrides,
+                   const std::vector<uint32_t>& reductionAxes,
+                   std::vector<uint32_t> reductionShape,
+                   std::vector<uint32_t> reductionStrides,
+                   bool disableSubgroups,
+                   const ReducePrologue& prologue) {
+  // The order of reduction dims does not matter, move the one with smallest
+  // stride to the last so it is read as rows and its neighbor elements are
+  // read by neighbor threads. The arg reductions must keep the order as it
+  // decides the indices.
+  auto it = std::min_element(reductionStrides.begin(), reductionStrides.end());
+  size_t rowAxis = IsArgReduce(type) ? reductionStrides.size() - 1
+                                     : it - reductionStrides.begin();
+  std::rotate(reductionShape.begin() + rowAxis,
+              reductionShape.begin() + rowAxis + 1,
+              reductionShape.end());
+  std::rotate(reductionStrides.begin() + rowAxis,
+              reductionStrides.begin() + rowAxis + 1,
+              reductionStrides.end());
+  ReduceRow(device, type,
+            outputDataType, output, outputNumElements,
+            inputDataType, input, inputShape, inputStrides,
+            reductionAxes,
+            std::move(reductionShape),
+            std::move(reductionStrides),
+            disableSubgroups, {}, prologue);
+}
+
+void ReduceCol(Device& device,
+               ReduceType type,
+               DataType outputDataType,
+               const Buffer& output,
+               uint32_t outputNumElements,
+               DataType inputDataType,
+               const Buffer& input,
+               const std::vector<uint32_t>& inputShape,
+               const std::vector<uint32_t>& inputStrides,
+               const std::vector<uint32_t>& reductionAxes,
+               const std::vector<uint32_t>& reductionShape,
+               const std::vector<uint32_t>& reductionStrides,
+               bool disableSubgroups,
+               const ReducePrologue& prologue) {
+  if (HasStructTotal(type))
+    throw std::runtime_error(
+        "ReduceCol does not support arg reduce and mean/variance.");
+  CheckReducePrologue(type, prologue);
+  // The shape/strides used for locating where to read columns.
+  auto nonReductionShape = RemoveIndices(inputShape, reductionAxes);
+  auto nonReductionStrides = RemoveIndices(inputStrides, reductionAxes);
+  std::tie(nonReductionShape, nonReductionStrides) =
+      CollapseContiguousDims(nonReductionShape, nonReductionStrides);
+  uint32_t numReductions = NumElements(reductionShape);
+
+  // Each workgroup works on 32 columns, and when there are too few workgroups
+  // for a long reduction, split the reduction among more workgroups and reduce
+  // the partial results in a second pass.
+  const uint32_t workgroupSize = 256;
+  const uint32_t targetWorkgroupsCount = 128;
+  const uint32_t minSplitSize = 1024;
+  uint32_t numStrips = DivCeil(outputNumElements, 32u);
+  uint32_t splitCount = 1;
+  if (numStrips * 2 <= targetWorkgroupsCount &&
+      numReductions >= 2 * minSplitSize) {
+    splitCount = std::min(DivCeil(targetWorkgroupsCount, numStrips),
+                          DivCeil(numReductions, minSplitSize));
+  }
+  uint32_t splitSize = DivCeil(numReductions, splitCount);
+  splitCount = DivCeil(numReductions, splitSize);
+  // The strips are laid out in 2D when exceeding the limit of one dimension.
+  uint32_t maxWorkgroups = device.GetLimits().maxComputeWorkgroupsPerDimension;
+  Buffer partials;
+  if (splitCount > 1) {
+    Device::MemoryScope intermediateScope(device,
+                                          MemoryCategory::Intermediates);
+    partials = device.CreateBuffer(
+        outputNumElements * splitCount * SizeOf(outputDataType),
+        BufferUsage::Storage);
+  }
+
+  const char* op = ReduceTypeToString(type, outputDataType);
+  // The columns are reduced in registers and workgroup memory.
+  bool enableF16 = EnableF16(device, outputDataType, inputDataType);
+  auto capacities = GetCapacityVariables(device, enableF16, true);
+  std::vector<Buffer> buffers = {
+    splitCount > 1 ? partials : output,
+    device.CreateBufferFromScalar(outputNumElements),
+    input,
+    device.CreateBufferFromScalar(numReductions),
+    device.CreateBufferFromScalar(splitSize),
+    nonReductionShape.empty()
+        ? device.CreateBufferFromScalar(0u)
+        : device.CreateBufferFromVector(nonReductionShape),
+    nonReductionStrides.empty()
+        ? device.CreateBufferFromScalar(0u)
+        : device.CreateBufferFromVector(nonReductionStrides),
+    device.CreateBufferFromVector(reductionShape),
+    device.CreateBufferFromVector(reductionStrides),
+  };
+  AddPrologueBuffers(prologue, buffers, capacities);
+  RunKernel(device,
+            fmt::format("reduce_col_{}", op),
+            fmt::format("reduce_col_{}_{}_{}_{}_{}",
+                        op,
+                        workgroupSize,
+                        WgslType(outputDataType),
+                        WgslType(inputDataType),
+                        GetPrologueKey(prologue)),
+            [&]() {
+              return Append(GetReduceShaderCode(wgsl_source_reduce_col,
+                                                op,
+                                                capacities,
+                                                outputDataType,
+                                                inputDataType,
+                                                workgroupSize,
+                                                false,
+                                                prologue),
+                            wgsl_source_utils);
+            },
+            std::move(buffers),
+            {std::min(numStrips, maxWorkgroups),
+             splitCount,
+             DivCeil(numStrips, maxWorkgroups)});
+  if (splitCount > 1) {
+    ReduceLast(device, type, outputDataType, output, outputNumElements,
+               outputDataType, partials, splitCount, disableSubgroups);
+  }
 }
 
 void ReduceNone(Device& device,
@@ -322,14 +788,16 @@ void Reduce(Device& device,
             uint32_t inputNumElements,
             const std::vector<uint32_t>& inputShape,
             const std::vector<uint32_t>& inputStrides,
-            const std::vector<uint32_t>& reductionAxes) {
+            const std::vector<uint32_t>& reductionAxes,
+            const ReducePrologue& prologue) {
   if (inputNumElements == 0) {
     return ReduceNone(device, type, outputDataType, output, outputNumElements);
   }
   if (plan.type == ReductionPlanType::ReduceAll) {
     return ReduceAll(device, type,
                      outputDataType, output,
-                     inputDataType, input, inputNumElements);
+                     inputDataType, input, inputNumElements,
+                     false, {}, prologue);
   }
   if (plan.type == ReductionPlanType::ReduceRow) {
     return ReduceRow(device, type,
@@ -337,9 +805,47 @@ void Reduce(Device& device,
                      inputDataType, input, inputShape, inputStrides,
                      reductionAxes,
                      std::move(plan.reductionShape),
-                     std::move(plan.reductionStrides));
+                     std::move(plan.reductionStrides),
+                     false, {}, prologue);
+  }
+  if (plan.type == ReductionPlanType::ReduceCol && !HasStructTotal(type)) {
+    return ReduceCol(device, type,
+                     outputDataType, output, outputNumElements,
+                     inputDataType, input, inputShape, inputStrides,
+                     reductionAxes,
+                     plan.reductionShape,
+                     plan.reductionStrides,
+                     false, prologue);
   }
-  throw std::runtime_error("Non-row-contiguous reduce is not implemented.");
+  return ReduceGeneral(device, type,
+                       outputDataType, output, outputNumElements,
+                       inputDataType, input, inputShape, inputStrides,
+                       reductionAxes,
+                       std::move(plan.reductionShape),
+                       std::move(plan.reductionStrides),
+                       false, prologue);
+}
+
+void Reduce(Device& device,
+            ReduceType type,
+            DataType outputDataType,
+            const Buffer& output,
+            uint32_t outputNumElements,
+            DataType inputDataType,
+            const Buffer& input,
+            uint32_t inputNumElements,
+            const std::vector<uint32_t>& inputShape,
+            const std::vector<uint32_t>& inputStrides,
+            const std::vector<uint32_t>& reductionAxes,
+            const ReducePrologue& prologue) {
+  Reduce(device,
+         GetReductionPlan(inputShape, inputStrides, reductionAxes,
+                          IsArgReduce(type)),
+         type,
+         outputDataType, output, outputNumElements,
+         inputDataType, input, inputNumElements,
+         inputShape, inputStrides, reductionAxes,
+         prologue);
 }
 
 }  // namespace betann
@@ -6,6 +6,13 @@
 namespace betann {
 
 // Reduce contiguous input to one output.
+//
+// For ArgMin/ArgMax the |outputValues| can be set to also write the values of
+// the indices found, which has the data type of input. For MeanVariance it
+// receives the variances, which has the data type of output.
+//
+// The |prologue| ops are applied to input elements before reducing them, which
+// are not supported by arg reduce. Same with below.
 void ReduceAll(Device& device,
                ReduceType type,
                DataType outputDataType,
@@ -13,7 +20,9 @@ void ReduceAll(Device& device,
                DataType inputDataType,
                const Buffer& input,
                uint32_t inputNumElements,
-               bool disableSubgroups = false);
+               bool disableSubgroups = false,
+               const Buffer& outputValues = {},
+               const ReducePrologue& prologue = {});
 
 // Reduce the last dimension in contiguous input.
 void ReduceLast(Device& device,
@@ -24,9 +33,12 @@ void ReduceLast(Device& device,
                 DataType inputDataType,
                 const Buffer& input,
                 uint32_t rowSize,
-                bool disableSubgroups = false);
+                bool disableSubgroups = false,
+                const Buffer& outputValues = {},
+                const ReducePrologue& prologue = {});
 
-// Reduce contiguous rows of input.
+// Reduce rows of input, the rows are contiguous when the last reduction stride
+// is 1.
 void ReduceRow(Device& device,
                ReduceType type,
                DataType outputDataType,
@@ -39,7 +51,43 @@ void ReduceRow(Device& device,
                const std::vector<uint32_t>& reductionAxes,
                std::vector<uint32_t> reductionShape,
                std::vector<uint32_t> reductionStrides,
-               bool disableSubgroups = false);
+               bool disableSubgroups = false,
+               const Buffer& outputValues = {},
+               const ReducePrologue& prologue = {});
+
+// Reduce input where the innermost non-reduction dimension is contiguous, so
+// neighbor outputs read neighbor columns.
+void ReduceCol(Device& device,
+               ReduceType type,
+               DataType outputDataType,
+               const Buffer& output,
+               uint32_t outputNumElements,
+               DataType inputDataType,
+               const Buffer& input,
+               const std::vector<uint32_t>& inputShape,
+               const std::vector<uint32_t>& inputStrides,
+               const std::vector<uint32_t>& reductionAxes,
+               const std::vector<uint32_t>& reductionShape,
+               const std::vector<uint32_t>& reductionStrides,
+               bool disableSubgroups = false,
+               const ReducePrologue& prologue = {});
+
+// Reduce input with arbitrary reduction axes and strides, by reading the
+// reduction dimension with smallest stride as rows.
+void ReduceGeneral(Device& device,
+                   ReduceType type,
+                   DataType outputDataType,
+                   const Buffer& output,
+                   uint32_t outputNumElements,
+                   DataType inputDataType,
+                   const Buffer& input,
+                   const std::vector<uint32_t>& inputShape,
+                   const std::vector<uint32_t>& inputStrides,
+                   const std::vector<uint32_t>& reductionAxes,
+                   std::vector<uint32_t> reductionShape,
+                   std::vector<uint32_t> reductionStrides,
+                   bool disableSubgroups = false,
+                   const ReducePrologue& prologue = {});
 
 // Write initial values to output.
 void ReduceNone(Device& device,
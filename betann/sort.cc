@@ -0,0 +1,494 @@
+#include "betann/sort.h"
+
+#include <algorithm>
+
+#include <fmt/format.h>
+
+#include "betann/kernels_helper.h"
+#include "wgsl_sources.h"
+
+namespace betann {
+
+namespace {
+
+std::vector<uint32_t> RemoveAxis(const std::vector<uint32_t>& input,
+                                 uint32_t axis) {
+  auto ret = input;
+  ret.erase(ret.begin() + axis);
+  return ret;
+}
+
+// Push the shape and strides of the non-sorted dimensions, a zero buffer is
+// used for each when there is no such dimension.
+void AddRestInfo(Device& device,
+                 std::vector<Buffer>& buffers,
+                 std::initializer_list<std::vector<uint32_t>> infos) {
+  for (const auto& info : infos) {
+    if (info.empty()) {
+      buffers.push_back(device.CreateBufferFromScalar(
+          0, DataType::U32, BufferUsage::Storage));
+    } else {
+      buffers.push_back(device.CreateBufferFromVector(info));
+    }
+  }
+}
+
+// Strides of rows along axis that are contiguous and packed one after another,
+// with the rest dimensions kept in row-major order.
+std::vector<uint32_t> PackedRowsStrides(const std::vector<uint32_t>& shape,
+                                        uint32_t axis) {
+  std::vector<uint32_t> strides(shape.size());
+  uint32_t stride = shape[axis];
+  for (size_t i = shape.size(); i > 0; --i) {
+    if (i - 1 == axis) {
+      strides[i - 1] = 1;
+    } else {
+      strides[i - 1] = stride;
+      stride *= shape[i - 1];
+    }
+  }
+  return strides;
+}
+
+// Radix sort is used when the rows are long enough to outweigh its fixed
+// number of passes.
+bool ShouldUseRadixSort(uint32_t axis,
+                        const std::vector<uint32_t>& outStrides,
+                        DataType inputDataType,
+                        const std::vector<uint32_t>& inputShape,
+                        const std::vector<uint32_t>& inputStrides) {
+  if (inputDataType == DataType::Bool)
+    return false;
+  if (inputShape[axis] < 16 * SortBlockSize())
+    return false;
+  auto strides = PackedRowsStrides(inputShape, axis);
+  return outStrides == strides && inputStrides == strides;
+}
+
+// Variables of radix_keys.wgsl, which maps keys to ordered unsigned bits.
+VariablesMap GetKeyVariables(Device& device, DataType dataType) {
+  return {
+    {"enable_f16", EnableF16(device, dataType)},
+    {"dtype", WgslType(dataType)},
+    {"key_bits", static_cast<uint32_t>(SizeOf(dataType) * 8)},
+    {"key_is_f16", dataType == DataType::F16},
+    {"key_is_float", dataType == DataType::F16 || dataType == DataType::F32},
+    {"key_is_signed", dataType == DataType::I32},
+  };
+}
+
+std::string GetSortShaderCode(const char* source,
+                              DataType dataType,
+                              bool enableF16,
+                              bool argsort,
+                              uint32_t blockSize,
+                              const VariablesMap& variables) {
+  const uint32_t workPerThread = 8;
+  VariablesMap sortVariables = {
+    {"enable_f16", enableF16},
+    {"dtype", WgslType(dataType)},
+    {"argsort", argsort},
+    {"num_threads", blockSize / workPerThread},
+    {"rows_per_workgroup", SortBlockSize() / blockSize},
+  };
+  return Append(ParseTemplate(source, variables, sortVariables),
+                ParseTemplate(wgsl_source_sort_ops, sortVariables),
+                wgsl_source_utils,
+                ParseTemplate(wgsl_source_constants, sortVariables));
+}
+
+// Sort each block of the sorted axis. When |outIndices| is set, the |out|
+// receives sorted values and |outIndices| receives their indices.
+void RunSortBlock(Device& device,
+                  uint32_t axis,
+                  SortInputType inputType,
+                  SortResultType resultType,
+                  const Buffer& out,
+                  const std::vector<uint32_t>& outStrides,
+                  DataType inputDataType,
+                  const Buffer& input,
+                  const std::vector<uint32_t>& inputShape,
+                  const std::vector<uint32_t>& inputStrides,
+                  const Buffer& outIndices = {}) {
+  uint32_t sizeSortedAxis = inputShape[axis];
+  std::vector<Buffer> buffers = {
+      out,
+      device.CreateBufferFromScalar(sizeSortedAxis),
+      device.CreateBufferFromScalar(outStrides[axis]),
+      input,
+      device.CreateBufferFromScalar(inputStrides[axis]),
+  };
+  auto outRestStrides = RemoveAxis(outStrides, axis);
+  auto inputRestStrides = RemoveAxis(inputStrides, axis);
+  bool contiguous = inputType == SortInputType::Contiguous;
+  if (contiguous) {
+    buffers.push_back(device.CreateBufferFromScalar(
+        *std::min_element(outRestStrides.begin(), outRestStrides.end())));
+    buffers.push_back(device.CreateBufferFromScalar(
+        *std::min_element(inputRestStrides.begin(), inputRestStrides.end())));
+  } else {
+    AddRestInfo(device, buffers, {outRestStrides,
+                                  RemoveAxis(inputShape, axis),
+                                  inputRestStrides});
+  }
+  uint32_t numRows = NumElements(inputShape) / sizeSortedAxis;
+  bool argsort = resultType == SortResultType::Indices;
+  bool writeValues = argsort && outIndices;
+  VariablesMap variables = {
+    {"contiguous", contiguous},
+    {"write_values", writeValues},
+  };
+  variables["num_rows_binding"] = static_cast<uint32_t>(buffers.size());
+  buffers.push_back(device.CreateBufferFromScalar(numRows));
+  if (writeValues) {
+    variables["out_idxs_binding"] = static_cast<uint32_t>(buffers.size());
+    buffers.push_back(outIndices);
+  }
+  // Short rows are sorted in smaller blocks with fewer threads, and multiple
+  // rows are packed in one workgroup so each workgroup still has the same
+  // number of threads and elements.
+  uint32_t blockSize = SortBlockSize();
+  while (blockSize > 32 && blockSize / 2 >= sizeSortedAxis)
+    blockSize /= 2;
+  uint32_t rowsPerWorkgroup = SortBlockSize() / blockSize;
+  uint32_t numBlocks = DivCeil(sizeSortedAxis, blockSize);
+  RunKernel(device,
+            "sort_block",
+            fmt::format("sort_{}_{}_{}_{}_{}",
+                        WgslType(inputDataType),
+                        argsort,
+                        contiguous,
+                        writeValues,
+                        blockSize),
+            [&]() {
+              return GetSortShaderCode(wgsl_source_sort_block,
+                                       inputDataType,
+                                       EnableF16(device, inputDataType),
+                                       argsort,
+                                       blockSize,
+                                       variables);
+            },
+            buffers,
+            {numBlocks, DivCeil(numRows, rowsPerWorkgroup), 1});
+}
+
+}  // namespace
+
+uint32_t SortBlockSize() {
+  const uint32_t workgroupSize = 256;  // TODO(zcbenz): make it dynamic
+  const uint32_t workPerThread = 8;
+  return  workgroupSize * workPerThread;
+}
+
+void SortBlock(Device& device,
+               uint32_t axis,
+               SortInputType inputType,
+               SortResultType resultType,
+               const Buffer& out,
+               const std::vector<uint32_t>& outStrides,
+               DataType inputDataType,
+               const Buffer& input,
+               const std::vector<uint32_t>& inputShape,
+               const std::vector<uint32_t>& inputStrides) {
+  uint32_t sizeSortedAxis = inputShape[axis];
+  if (sizeSortedAxis > SortBlockSize()) {
+    throw std::runtime_error(
+        fmt::format("Elements number of sorted axis ({}) exceeds limit ({}).",
+                    sizeSortedAxis, SortBlockSize()));
+  }
+  RunSortBlock(device, axis, inputType, resultType, out, outStrides,
+               inputDataType, input, inputShape, inputStrides);
+}
+
+void SortMultiBlock(Device& device,
+                    uint32_t axis,
+                    SortInputType inputType,
+                    SortResultType resultType,
+                    const Buffer& out,
+                    const std::vector<uint32_t>& outStrides,
+                    DataType inputDataType,
+                    const Buffer& input,
+                    const std::vector<uint32_t>& inputShape,
+                    const std::vector<uint32_t>& inputStrides) {
+  uint32_t sizeSortedAxis = inputShape[axis];
+  uint32_t numRows = NumElements(inputShape) / sizeSortedAxis;
+  uint32_t numBlocks = DivCeil(sizeSortedAxis, SortBlockSize());
+  bool argsort = resultType == SortResultType::Indices;
+
+  // The blocks are sorted and merged in temporary buffers laid out as
+  // [rows, sizeSortedAxis], and the merge passes ping-pong between them.
+  Buffer vals[2];
+  Buffer idxs[2];
+  {
+    Device::MemoryScope intermediateScope(device,
+                                          MemoryCategory::Intermediates);
+    for (int i = 0; i < 2; ++i) {
+      vals[i] = device.CreateBuffer(
+          numRows * sizeSortedAxis * SizeOf(inputDataType),
+          BufferUsage::Storage);
+      if (argsort) {
+        idxs[i] = device.CreateBuffer(
+            numRows * sizeSortedAxis * sizeof(uint32_t),
+            BufferUsage::Storage);
+      }
+    }
+  }
+  RunSortBlock(device, axis, inputType, resultType, vals[0],
+               PackedRowsStrides(inputShape, axis),
+               inputDataType, input, inputShape, inputStrides, idxs[0]);
+
+  // Each pass merges pairs of sorted ranges of (mergeTiles / 2) blocks, and the
+  // last pass writes to output.
+  auto outRestShape = RemoveAxis(inputShape, axis);
+  auto outRestStrides = RemoveAxis(outStrides, axis);
+  bool enableF16 = EnableF16(device, inputDataType);
+  int src = 0;
+  for (uint32_t mergeTiles = 2; mergeTiles / 2 < numBlocks; mergeTiles *= 2) {
+    bool last = mergeTiles >= numBlocks;
+    std::vector<Buffer> buffers = {
+      last ? out : vals[1 - src],
+      device.CreateBufferFromScalar(sizeSortedAxis),
+      vals[src],
+      device.CreateBufferFromScalar(mergeTiles),
+    };
+    if (last) {
+      buffers.push_back(device.CreateBufferFromScalar(outStrides[axis]));
+      AddRestInfo(device, buffers, {outRestShape, outRestStrides});
+      if (argsort)
+        buffers.push_back(idxs[src]);
+    } else if (argsort) {
+      buffers.push_back(idxs[src]);
+      buffers.push_back(idxs[1 - src]);
+    }
+    RunKernel(device,
+              "sort_merge",
+              fmt::format("sort_merge_{}_{}_{}",
+                          WgslType(inputDataType),
+                          argsort,
+                          last),
+              [&]() {
+                return GetSortShaderCode(wgsl_source_sort_merge,
+                                         inputDataType,
+                                         enableF16,
+                                         argsort,
+                                         SortBlockSize(),
+                                         {{"write_output", last}});
+              },
+              std::move(buffers),
+              {numBlocks, numRows, 1});
+    src = 1 - src;
+  }
+}
+
+void RadixSort(Device& device,
+               SortResultType resultType,
+               const Buffer& out,
+               DataType inputDataType,
+               const Buffer& input,
+               uint32_t numRows,
+               uint32_t sizeSortedAxis) {
+  if (inputDataType == DataType::Bool)
+    throw std::runtime_error("Radix sort does not support bool keys.");
+  // Each workgroup counts and scatters a tile of the sorted axis, the sizes
+  // are passed to the shaders so they always agree with the host.
+  const uint32_t radixBits = 4;
+  const uint32_t numThreads = 128;
+  const uint32_t workPerThread = 8;
+  const uint32_t tileSize = numThreads * workPerThread;
+  uint32_t numTiles = DivCeil(sizeSortedAxis, tileSize);
+  uint32_t keyBits = SizeOf(inputDataType) * 8;
+  bool argsort = resultType == SortResultType::Indices;
+
+  // The keys are stored as ordered bits between passes, and the digit counts
+  // of each tile are laid out as [rows, radix, tiles].
+  Buffer keys[2];
+  Buffer idxs[2];
+  Buffer histograms;
+  {
+    Device::MemoryScope intermediateScope(device,
+                                          MemoryCategory::Intermediates);
+    for (int i = 0; i < 2; ++i) {
+      keys[i] = device.CreateBuffer(
+          numRows * sizeSortedAxis * sizeof(uint32_t),
+          BufferUsage::Storage);
+      if (argsort) {
+        idxs[i] = device.CreateBuffer(
+            numRows * sizeSortedAxis * sizeof(uint32_t),
+            BufferUsage::Storage);
+      }
+    }
+    histograms = device.CreateBuffer(
+        numRows * (1 << radixBits) * numTiles * sizeof(uint32_t),
+        BufferUsage::Storage);
+  }
+
+  VariablesMap opsVariables = {
+    {"radix_bits", radixBits},
+    {"num_threads", numThreads},
+    {"work_per_thread", workPerThread},
+  };
+  VariablesMap keyVariables = GetKeyVariables(device, inputDataType);
+  keyVariables["has_keys"] = true;
+  Buffer size = device.CreateBufferFromScalar(sizeSortedAxis);
+  // Each pass reads from the buffers written by previous pass, starting from
+  // input, and the last pass writes to output.
+  uint32_t numPasses = keyBits / radixBits;
+  for (uint32_t pass = 0; pass < numPasses; ++pass) {
+    bool first = pass == 0;
+    bool last = pass == numPasses - 1;
+    const Buffer& keysIn = first ? input : keys[(pass + 1) % 2];
+    Buffer shift = device.CreateBufferFromScalar(pass * radixBits);
+    VariablesMap variables = keyVariables;
+    variables["first_pass"] = first;
+    RunKernel(device,
+              "radix_count",
+              fmt::format("radix_count_{}_{}", WgslType(inputDataType), first),
+              [&]() {
+                return Append(
+                    ParseTemplate(wgsl_source_radix_count, variables),
+                    ParseTemplate(wgsl_source_radix_ops,
+                                  variables,
+                                  opsVariables),
+                    ParseTemplate(wgsl_source_radix_keys, variables));
+              },
+              {histograms, size, shift, keysIn},
+              {numTiles, numRows, 1});
+    RunKernel(device,
+              "radix_scan",
+              "radix_scan",
+              [&]() {
+                return Append(
+                    wgsl_source_radix_scan,
+                    ParseTemplate(wgsl_source_radix_ops,
+                                  {{"has_keys", false}},
+                                  opsVariables));
+              },
+              {histograms, device.CreateBufferFromScalar(numTiles)},
+              {1, numRows, 1});
+    std::vector<Buffer> buffers = {
+      last ? out : keys[pass % 2],
+      size,
+      shift,
+      keysIn,
+      histograms,
+    };
+    variables["argsort"] = argsort;
+    variables["last_pass"] = last;
+    if (argsort && !last) {
+      variables["idxs_out_binding"] = static_cast<uint32_t>(buffers.size());
+      buffers.push_back(idxs[pass % 2]);
+    }
+    if (argsort && !first) {
+      variables["idxs_in_binding"] = static_cast<uint32_t>(buffers.size());
+      buffers.push_back(idxs[(pass + 1) % 2]);
+    }
+    RunKernel(device,
+              "radix_scatter",
+              fmt::format("radix_scatter_{}_{}_{}_{}",
+                          WgslType(inputDataType),
+                          argsort,
+                          first,
+                          last),
+              [&]() {
+                return Append(
+                    ParseTemplate(wgsl_source_radix_scatter, variables),
+                    ParseTemplate(wgsl_source_radix_ops,
+                                  variables,
+                                  opsVariables),
+                    ParseTemplate(wgsl_source_radix_keys, variables));
+              },
+              std::move(buffers),
+              {numTiles, numRows, 1});
+  }
+}
+
+void Sort(Device& device,
+          uint32_t axis,
+          SortInputType inputType,
+          SortResultType resultType,
+          const Buffer& out,
+          const std::vector<uint32_t>& outStrides,
+          DataType inputDataType,
+          const Buffer& input,
+          const std::vector<uint32_t>& inputShape,
+          const std::vector<uint32_t>& inputStrides) {
+  if (ShouldUseRadixSort(axis, outStrides, inputDataType,
+                         inputShape, inputStrides)) {
+    RadixSort(device, resultType, out, inputDataType, input,
+              NumElements(inputShape) / inputShape[axis], inputShape[axis]);
+  } else if (inputShape[axis] <= SortBlockSize()) {
+    SortBlock(device, axis, inputType, resultType, out, outStrides,
+              inputDataType, input, inputShape, inputStrides);
+  } else {
+    SortMultiBlock(device, axis, inputType, resultType, out, outStrides,
+                   inputDataType, input, inputShape, inputStrides);
+  }
+}
+
+void TopK(Device& device,
+          uint32_t axis,
+          uint32_t k,
+          const Buffer& outValues,
+          const Buffer& outIndices,
+          const std::vector<uint32_t>& outStrides,
+          DataType inputDataType,
+          const Buffer& input,
+          const std::vector<uint32_t>& inputShape,
+          const std::vector<uint32_t>& inputStrides) {
+  uint32_t sizeSortedAxis = inputShape[axis];
+  if (k == 0 || k > sizeSortedAxis) {
+    throw std::runtime_error(
+        fmt::format("The k ({}) must be between 1 and the elements number of "
+                    "axis ({}).", k, sizeSortedAxis));
+  }
+  if (inputDataType == DataType::Bool)
+    throw std::runtime_error("TopK does not support bool input.");
+  if (!outValues && !outIndices)
+    throw std::runtime_error("TopK requires at least one output.");
+  std::vector<Buffer> buffers = {
+    input,
+    device.CreateBufferFromScalar(sizeSortedAxis),
+    device.CreateBufferFromScalar(inputStrides[axis]),
+    device.CreateBufferFromScalar(k),
+  };
+  AddRestInfo(device, buffers, {RemoveAxis(inputShape, axis),
+                                RemoveAxis(inputStrides, axis)});
+  buffers.push_back(device.CreateBufferFromScalar(outStrides[axis]));
+  AddRestInfo(device, buffers, {RemoveAxis(outStrides, axis)});
+  VariablesMap variables = GetKeyVariables(device, inputDataType);
+  variables["has_values"] = static_cast<bool>(outValues);
+  variables["has_indices"] = static_cast<bool>(outIndices);
+  if (outValues) {
+    variables["values_binding"] = static_cast<uint32_t>(buffers.size());
+    buffers.push_back(outValues);
+  }
+  if (outIndices) {
+    variables["indices_binding"] = static_cast<uint32_t>(buffers.size());
+    buffers.push_back(outIndices);
+  }
+  // Small k is found by keeping candidates in registers, otherwise the k-th
+  // largest element is found by radix select.
+  bool useInsert = k <= 32;
+  uint32_t maxK = 4;
+  while (useInsert && maxK < k)
+    maxK *= 2;
+  variables["max_k"] = maxK;
+  const char* entry = useInsert ? "topk_insert" : "topk_select";
+  RunKernel(device,
+            entry,
+            fmt::format("{}_{}_{}_{}_{}",
+                        entry,
+                        WgslType(inputDataType),
+                        maxK,
+                        static_cast<bool>(outValues),
+                        static_cast<bool>(outIndices)),
+            [&]() {
+              return Append(ParseTemplate(wgsl_source_topk, variables),
+                            ParseTemplate(wgsl_source_radix_keys, variables),
+                            wgsl_source_utils);
+            },
+            std::move(buffers),
+            {1, NumElements(inputShape) / sizeSortedAxis, 1});
+}
+
+}  // namespace betann
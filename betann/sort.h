@@ -0,0 +1,34 @@
+#ifndef BETANN_SORT_H_
+#define BETANN_SORT_H_
+
+#include "betann/kernels.h"
+
+namespace betann {
+
+// Sort input whose sorted axis exceeds one block, by sorting each block first
+// and then merging sorted blocks in log2(blocks) passes.
+void SortMultiBlock(Device& device,
+                    uint32_t axis,
+                    SortInputType inputType,
+                    SortResultType resultType,
+                    const Buffer& out,
+                    const std::vector<uint32_t>& outStrides,
+                    DataType inputDataType,
+                    const Buffer& input,
+                    const std::vector<uint32_t>& inputShape,
+                    const std::vector<uint32_t>& inputStrides);
+
+// Sort rows of 32-bit or 16-bit keys with LSD radix sort, each pass counts the
+// digits of each tile, scans the counts and scatters keys stably. The rows must
+// be contiguous and packed one after another in both input and output.
+void RadixSort(Device& device,
+               SortResultType resultType,
+               const Buffer& out,
+               DataType inputDataType,
+               const Buffer& input,
+               uint32_t numRows,
+               uint32_t sizeSortedAxis);
+
+}  // namespace betann
+
+#endif  // BETANN_SORT_H_
@@ -0,0 +1,199 @@
+#include "betann/upload_ring.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+namespace betann {
+
+namespace {
+
+// Do not split small copies among threads.
+constexpr uint64_t kMinBytesPerTask = 1024 * 1024;
+
+}  // namespace
+
+UploadRing::UploadRing(Device& device,
+                       uint64_t chunkSize,
+                       size_t numChunks,
+                       uint32_t numThreads)
+    : device_(device),
+      chunkSize_(DivCeil(chunkSize, 4u) * 4),
+      chunks_(std::max<size_t>(numChunks, 1)) {
+  if (chunkSize == 0)
+    throw std::runtime_error("Chunk size of UploadRing must not be 0.");
+  for (uint32_t i = 0; i < std::max(numThreads, 1u); ++i)
+    workers_.emplace_back(&UploadRing::WorkerThread, this);
+}
+
+UploadRing::~UploadRing() {
+  try {
+    WaitAll();
+  } catch (...) {
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  tasksChanged_.notify_all();
+  for (std::thread& worker : workers_)
+    worker.join();
+}
+
+wgpu::Future UploadRing::Upload(const void* data,
+                                uint64_t size,
+                                const Buffer& dst,
+                                uint64_t dstOffset) {
+  if (device_.IsCapturing())
+    throw std::runtime_error("Can not upload while capturing commands.");
+  if (size % 4 != 0 || dstOffset % 4 != 0) {
+    throw std::runtime_error(
+        fmt::format("Upload size {} and offset {} must be multiples of 4.",
+                    size, dstOffset));
+  }
+  if (size == 0)
+    return device_.OnSubmittedWorkDone([]() {});
+  // Chunks are filled and submitted in batches of half the ring, so the next
+  // batch can be filled while the previous one is being copied.
+  size_t batchSize = std::max<size_t>(chunks_.size() / 2, 1);
+  wgpu::Future future;
+  for (uint64_t offset = 0; offset < size;) {
+    struct Pending {
+      Chunk* chunk;
+      uint64_t offset;
+      uint64_t size;
+    };
+    std::vector<Pending> batch;
+    try {
+      for (; batch.size() < batchSize && offset < size; offset += chunkSize_) {
+        uint64_t chunkBytes = std::min(chunkSize_, size - offset);
+        Chunk& chunk = AcquireChunk();
+        FillChunk(chunk.staging.data.GetMappedRange(),
+                  static_cast<const char*>(data) + offset,
+                  chunkBytes);
+        batch.push_back({&chunk, offset, chunkBytes});
+      }
+    } catch (...) {
+      // Do not leave workers writing into the host data after returning.
+      WaitForFills();
+      throw;
+    }
+    WaitForFills();
+    for (const Pending& pending : batch) {
+      pending.chunk->staging.data.Unmap();
+      device_.CopyBufferToBuffer(pending.chunk->staging, 0,
+                                 dst, dst.offset + dstOffset + pending.offset,
+                                 pending.size);
+    }
+    device_.Flush();
+    // The mapping finishes after the copies have been executed, and the order
+    // of submissions guarantees that previous chunks have also been copied.
+    for (const Pending& pending : batch) {
+      Chunk* chunk = pending.chunk;
+      chunk->mapped = chunk->staging.data.MapAsync(
+          wgpu::MapMode::Write,
+          0,
+          chunkSize_,
+          wgpu::CallbackMode::WaitAnyOnly,
+          [chunk](wgpu::MapAsyncStatus status, const char* message) {
+            chunk->mapStatus = status;
+            chunk->mapMessage = message ? message : "";
+          });
+      chunk->pending = true;
+      future = chunk->mapped;
+    }
+  }
+  return future;
+}
+
+Buffer UploadRing::CreateBufferFromData(const void* data,
+                                        uint64_t size,
+                                        BufferUsage usage) {
+  Buffer buffer = device_.CreateBuffer(DivCeil(size, 4u) * 4,
+                                       usage | BufferUsage::CopyDst);
+  uint64_t aligned = DivFloor(size, 4u) * 4;
+  Upload(data, aligned, buffer);
+  if (aligned < size) {
+    uint32_t tail = 0;
+    std::memcpy(&tail, static_cast<const char*>(data) + aligned,
+                size - aligned);
+    Upload(&tail, sizeof(tail), buffer, aligned);
+  }
+  return buffer;
+}
+
+void UploadRing::WaitAll() {
+  for (Chunk& chunk : chunks_)
+    WaitForChunk(chunk);
+}
+
+UploadRing::Chunk& UploadRing::AcquireChunk() {
+  Chunk& chunk = chunks_[next_];
+  next_ = (next_ + 1) % chunks_.size();
+  if (!chunk.staging) {
+    Device::MemoryScope memoryScope(device_, MemoryCategory::Staging);
+    chunk.staging = device_.CreateBuffer(
+        chunkSize_,
+        BufferUsage::MapWrite | BufferUsage::CopySrc,
+        true);
+  } else {
+    WaitForChunk(chunk);
+  }
+  return chunk;
+}
+
+void UploadRing::WaitForChunk(Chunk& chunk) {
+  if (!chunk.pending)
+    return;
+  device_.WaitFor(chunk.mapped);
+  chunk.pending = false;
+  if (chunk.mapStatus != wgpu::MapAsyncStatus::Success) {
+    // The staging buffer can not be used anymore, create a new one next time.
+    chunk.staging = nullptr;
+    throw std::runtime_error(
+        fmt::format("MapAsync failed: {}", chunk.mapMessage));
+  }
+}
+
+void UploadRing::FillChunk(void* dst, const void* src, uint64_t size) {
+  uint64_t numTasks = std::min<uint64_t>(
+      workers_.size(), std::max<uint64_t>(size / kMinBytesPerTask, 1));
+  uint64_t bytesPerTask = DivCeil(DivCeil(size, numTasks), 4u) * 4;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint64_t begin = 0; begin < size; begin += bytesPerTask) {
+      uint64_t end = std::min(begin + bytesPerTask, size);
+      tasks_.push_back([=]() {
+        std::memcpy(static_cast<char*>(dst) + begin,
+                    static_cast<const char*>(src) + begin,
+                    end - begin);
+      });
+      unfinishedTasks_++;
+    }
+  }
+  tasksChanged_.notify_all();
+}
+
+void UploadRing::WaitForFills() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  tasksChanged_.wait(lock, [this]() { return unfinishedTasks_ == 0; });
+}
+
+void UploadRing::WorkerThread() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    tasksChanged_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+    if (stop_)
+      return;
+    std::function<void()> task = std::move(tasks_.front());
+    tasks_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+    if (--unfinishedTasks_ == 0)
+      tasksChanged_.notify_all();
+  }
+}
+
+}  // namespace betann
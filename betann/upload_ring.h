@@ -0,0 +1,82 @@
+#ifndef BETANN_UPLOAD_RING_H_
+#define BETANN_UPLOAD_RING_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "betann/device.h"
+
+namespace betann {
+
+// Stream host data into device buffers through a ring of reusable staging
+// buffers. The mapped staging buffers are filled by worker threads owned by the
+// ring, and each half of the ring is submitted as one batch of copies, so
+// filling one half overlaps the GPU copies of the other half.
+class UploadRing {
+ public:
+  UploadRing(Device& device,
+             uint64_t chunkSize = 16 * 1024 * 1024,
+             size_t numChunks = 4,
+             uint32_t numThreads = 1);
+  ~UploadRing();
+
+  UploadRing(const UploadRing&) = delete;
+  UploadRing& operator=(const UploadRing&) = delete;
+
+  // Copy |size| bytes from |data| to |dst| at |dstOffset|, both |size| and
+  // |dstOffset| must be multiples of 4. The host data can be released once
+  // this method returns, and the returned future completes after the data has
+  // arrived in |dst|. Can not be called while the device is capturing.
+  wgpu::Future Upload(const void* data,
+                      uint64_t size,
+                      const Buffer& dst,
+                      uint64_t dstOffset = 0);
+
+  // Create a buffer and upload |data| to it.
+  Buffer CreateBufferFromData(const void* data,
+                              uint64_t size,
+                              BufferUsage usage = BufferUsage::Storage);
+
+  // Wait until all the uploads have finished.
+  void WaitAll();
+
+  uint64_t GetChunkSize() const { return chunkSize_; }
+
+ private:
+  struct Chunk {
+    Buffer staging;
+    // Set when the staging buffer is being copied and mapped again.
+    wgpu::Future mapped;
+    bool pending = false;
+    // Result of the last mapping, checked after waiting for it.
+    wgpu::MapAsyncStatus mapStatus = wgpu::MapAsyncStatus::Success;
+    std::string mapMessage;
+  };
+
+  Chunk& AcquireChunk();
+  void WaitForChunk(Chunk& chunk);
+  void FillChunk(void* dst, const void* src, uint64_t size);
+  void WaitForFills();
+  void WorkerThread();
+
+  Device& device_;
+  uint64_t chunkSize_;
+  std::vector<Chunk> chunks_;
+  size_t next_ = 0;
+
+  // Workers copying host data into staging buffers.
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable tasksChanged_;
+  std::deque<std::function<void()>> tasks_;
+  size_t unfinishedTasks_ = 0;
+  bool stop_ = false;
+};
+
+}  // namespace betann
+
+#endif  // BETANN_UPLOAD_RING_H_
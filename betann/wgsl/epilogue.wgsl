@@ -0,0 +1,41 @@
+// The epilogue of matrix multiplication, which is applied to the results before
+// writing them to output:
+// out = activation(alpha * result + beta * residual + bias)
+
+if ($has_epilogue) {
+  struct EpilogueParams {
+    alpha: f32,
+    beta: f32,
+    // The bias is indexed by (col * bias_stride).
+    bias_stride: u32,
+  }
+
+  @group(0) @binding($params_binding) var<uniform> epilogue_params: EpilogueParams;
+}
+if ($has_bias) {
+  @group(0) @binding($bias_binding) var<storage, read> epilogue_bias: array<dtype>;
+}
+if ($has_residual) {
+  @group(0) @binding($residual_binding) var<storage, read> epilogue_residual: array<dtype>;
+}
+if ($has_activation) {
+  alias input_dtype = dtype;
+}
+
+// The |index| is the offset in output, and |col| is the column in output.
+fn apply_epilogue(value: dtype, index: u32, col: u32) -> dtype {
+  var result = value;
+  if ($has_epilogue) {
+    result *= dtype(epilogue_params.alpha);
+  }
+  if ($has_residual) {
+    result += dtype(epilogue_params.beta) * epilogue_residual[index];
+  }
+  if ($has_bias) {
+    result += epilogue_bias[col * epilogue_params.bias_stride];
+  }
+  if ($has_activation) {
+    result = dtype(betann_$activation(result));
+  }
+  return result;
+}
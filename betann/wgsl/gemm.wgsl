@@ -0,0 +1,142 @@
+if ($enable_f16) {
+  enable f16;
+}
+if ($enable_subgroups) {
+  enable subgroups;
+}
+if ($enable_subgroups_f16) {
+  enable subgroups_f16;
+}
+
+alias dtype = $dtype;
+
+// Each thread computes (row_work_per_thread * col_work_per_thread) elements of
+// output, which are strided by the workgroup size so writes are coalesced.
+const row_work_per_thread: u32 = $row_work_per_thread;
+const col_work_per_thread: u32 = $col_work_per_thread;
+const workgroup_size_row: u32 = 16;
+const workgroup_size_col: u32 = 16;
+const workgroup_size = workgroup_size_row * workgroup_size_col;
+// Each workgroup computes a (tile_rows * tile_cols) tile of output, by walking
+// through the inner dimension in steps of tile_k.
+const tile_rows = workgroup_size_row * row_work_per_thread;
+const tile_cols = workgroup_size_col * col_work_per_thread;
+const tile_k: u32 = 16;
+if ($split_k) {
+  // Each workgroup works on split_size of the inner dimension, and writes
+  // partial results.
+  const split_size: u32 = $split_size;
+}
+
+@group(0) @binding(0) var<storage, read_write> out: array<dtype>;
+@group(0) @binding(1) var<storage, read> a: array<dtype>;
+@group(0) @binding(2) var<storage, read> b: array<dtype>;
+@group(0) @binding(3) var<uniform> m_size: u32;
+@group(0) @binding(4) var<uniform> n_size: u32;
+@group(0) @binding(5) var<uniform> k_size: u32;
+@group(0) @binding(6) var<uniform> a_leading_stride: u32;
+@group(0) @binding(7) var<uniform> b_leading_stride: u32;
+@group(0) @binding(8) var<storage, read> batch_strides_a: array<u32>;
+@group(0) @binding(9) var<storage, read> batch_strides_b: array<u32>;
+if (!$contiguous) {
+  @group(0) @binding(10) var<storage, read> batch_shape: array<u32>;
+}
+
+@compute @workgroup_size(workgroup_size_col, workgroup_size_row)
+fn gemm(if ($enable_subgroups) {
+          @builtin(subgroup_size) subgroup_size: u32,
+          @builtin(subgroup_invocation_id) subgroup_lane: u32,
+        }
+        @builtin(workgroup_id) tid: vec3<u32>,
+        @builtin(local_invocation_id) lid: vec3<u32>,
+        @builtin(local_invocation_index) index: u32) {
+  let tile_row = tid.y * tile_rows;
+  let tile_col = tid.x * tile_cols;
+
+  // The splits of inner dimension are dispatched as batches.
+  if ($split_k) {
+    let split_count = (k_size + split_size - 1) / split_size;
+    let batch = tid.z / split_count;
+    let split = tid.z % split_count;
+    let k_begin = split * split_size;
+    let k_end = min(k_begin + split_size, k_size);
+  } else {
+    let batch = tid.z;
+    let k_begin = 0u;
+    let k_end = k_size;
+  }
+
+  // Offset of current batch.
+  if ($contiguous) {
+    let a_offset = batch * batch_strides_a[0];
+    let b_offset = batch * batch_strides_b[0];
+  } else {
+    let a_offset = coord_to_index(batch, &batch_shape, &batch_strides_a);
+    let b_offset = coord_to_index(batch, &batch_shape, &batch_strides_b);
+  }
+
+  if ($enable_subgroups) {
+    let share_a = rows_in_subgroups(subgroup_size, subgroup_lane, lid);
+    let row_lane = subgroup_lane - lid.x;
+  }
+
+  // Per-thread results.
+  var result: array<array<dtype, col_work_per_thread>, row_work_per_thread>;
+
+  for (var k_start = k_begin; k_start < k_end; k_start += tile_k) {
+    load_a_tile(index, tile_row, k_start, k_end, a_offset, a_leading_stride);
+
+    // Load tile of b.
+    for (var j = 0u; j < col_work_per_thread; j++) {
+      let idx = index + j * workgroup_size;
+      if ($b_transposed) {
+        let c = idx / tile_k;
+        let k = idx % tile_k;
+      } else {
+        let c = idx % tile_cols;
+        let k = idx / tile_cols;
+      }
+      var value: dtype = 0;
+      if (tile_col + c < n_size && k_start + k < k_end) {
+        if ($b_transposed) {
+          value = b[b_offset + (tile_col + c) * b_leading_stride + k_start + k];
+        } else {
+          value = b[b_offset + (k_start + k) * b_leading_stride + tile_col + c];
+        }
+      }
+      b_tile[k * tile_cols + c] = value;
+    }
+    workgroupBarrier();
+
+    if ($enable_subgroups) {
+      multiply_tiles(&result, lid, share_a, row_lane);
+    } else {
+      multiply_tiles(&result, lid);
+    }
+    workgroupBarrier();
+  }
+
+  // Write output.
+  let out_offset = batch * m_size * n_size;
+  for (var i = 0u; i < row_work_per_thread; i++) {
+    let row = tile_row + lid.y + i * workgroup_size_row;
+    if (row >= m_size) {
+      break;
+    }
+    for (var j = 0u; j < col_work_per_thread; j++) {
+      let col = tile_col + lid.x + j * workgroup_size_col;
+      if (col < n_size) {
+        if ($split_k) {
+          out[(out_offset + row * n_size + col) * split_count + split] = result[i][j];
+        } else {
+          let out_idx = out_offset + row * n_size + col;
+          out[out_idx] = apply_epilogue(result[i][j], out_idx, col);
+        }
+      }
+    }
+  }
+}
+
+// include gemm_ops.wgsl
+// include epilogue.wgsl
+// include utils.wgsl
@@ -0,0 +1,119 @@
+// The tiled multiplication shared by gemm and qgemm, which define the sizes of
+// tiles and the |a| and |m_size| bindings.
+
+// The tiles are stored with inner dimension as rows, so each step of the
+// multiplication reads a contiguous row of both tiles.
+var<workgroup> a_tile: array<dtype, tile_k * tile_rows>;
+var<workgroup> b_tile: array<dtype, tile_k * tile_cols>;
+
+// Load the tile of a at |tile_row| and |k_start|, reading along the contiguous
+// dimension, where |a_stride| is the stride of the leading dimension.
+fn load_a_tile(index: u32,
+               tile_row: u32,
+               k_start: u32,
+               k_end: u32,
+               a_offset: u32,
+               a_stride: u32) {
+  for (var i = 0u; i < row_work_per_thread; i++) {
+    let idx = index + i * workgroup_size;
+    if ($a_transposed) {
+      let r = idx % tile_rows;
+      let k = idx / tile_rows;
+    } else {
+      let r = idx / tile_k;
+      let k = idx % tile_k;
+    }
+    var value: dtype = 0;
+    if (tile_row + r < m_size && k_start + k < k_end) {
+      if ($a_transposed) {
+        value = a[a_offset + (k_start + k) * a_stride + tile_row + r];
+      } else {
+        value = a[a_offset + (tile_row + r) * a_stride + k_start + k];
+      }
+    }
+    a_tile[k * tile_rows + r] = value;
+  }
+}
+
+// Multiply the loaded tiles and accumulate into |result|.
+fn multiply_tiles(
+    result: ptr<function, array<array<dtype, col_work_per_thread>, row_work_per_thread>>,
+    lid: vec3<u32>,
+    if ($enable_subgroups) {
+      share_a: bool,
+      row_lane: u32,
+    }) {
+  var a_values: array<dtype, row_work_per_thread>;
+  var b_values: array<dtype, col_work_per_thread>;
+
+  if ($enable_subgroups) {
+    // When rows of workgroup are laid out in subgroups, each lane reads one
+    // step of a and shares it with other lanes of the row.
+    var a_lane: array<dtype, row_work_per_thread>;
+    if (share_a) {
+      for (var i = 0u; i < row_work_per_thread; i++) {
+        a_lane[i] = a_tile[lid.x * tile_rows + lid.y + i * workgroup_size_row];
+      }
+    }
+  }
+
+  for (var k = 0u; k < tile_k; k++) {
+    if ($enable_subgroups) {
+      if (share_a) {
+        for (var i = 0u; i < row_work_per_thread; i++) {
+          a_values[i] = subgroupShuffle(a_lane[i], row_lane + k);
+        }
+      } else {
+        load_a_values(&a_values, k, lid.y);
+      }
+    } else {
+      load_a_values(&a_values, k, lid.y);
+    }
+    for (var j = 0u; j < col_work_per_thread; j++) {
+      b_values[j] = b_tile[k * tile_cols + lid.x + j * workgroup_size_col];
+    }
+    for (var i = 0u; i < row_work_per_thread; i++) {
+      for (var j = 0u; j < col_work_per_thread; j++) {
+        if ($dtype_is_floating) {
+          result[i][j] = fma(a_values[i], b_values[j], result[i][j]);
+        } else {
+          result[i][j] += a_values[i] * b_values[j];
+        }
+      }
+    }
+  }
+}
+
+fn load_a_values(dst: ptr<function, array<dtype, row_work_per_thread>>,
+                 k: u32,
+                 row: u32) {
+  for (var i = 0u; i < row_work_per_thread; i++) {
+    dst[i] = a_tile[k * tile_rows + row + i * workgroup_size_row];
+  }
+}
+
+if ($enable_subgroups) {
+  var<workgroup> workgroup_misplaced_lanes: atomic<u32>;
+  var<workgroup> workgroup_rows_in_subgroups: bool;
+
+  // Whether each row of workgroup is a contiguous run of lanes within one
+  // subgroup, which WGSL does not guarantee, so it is checked at runtime before
+  // sharing values among the lanes of a row.
+  fn rows_in_subgroups(subgroup_size: u32,
+                       subgroup_lane: u32,
+                       lid: vec3<u32>) -> bool {
+    let row_lane = select(0u, subgroup_lane - lid.x, subgroup_lane >= lid.x);
+    let row_start = subgroupShuffle(lid.y, row_lane);
+    if (subgroup_size % workgroup_size_col != 0 ||
+        subgroup_lane % workgroup_size_col != lid.x ||
+        row_start != lid.y) {
+      atomicAdd(&workgroup_misplaced_lanes, 1);
+    }
+    workgroupBarrier();
+    if (lid.x == 0 && lid.y == 0) {
+      workgroup_rows_in_subgroups =
+          atomicLoad(&workgroup_misplaced_lanes) == 0;
+    }
+    return workgroupUniformLoad(&workgroup_rows_in_subgroups);
+  }
+}
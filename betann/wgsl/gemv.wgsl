@@ -18,6 +18,10 @@ const col_work_per_thread: u32 = $col_work_per_thread;
 // Each thread works on (mat_cols / workgroup_size_col) columns.
 const workgroup_size_row: u32 = $group_count;
 const workgroup_size_col: u32 = 32;
+if ($split_k) {
+  // Each workgroup works on split_size cols, and writes partial results.
+  const split_size: u32 = $split_size;
+}
 
 @group(0) @binding(0) var<storage, read_write> out: array<dtype>;
 @group(0) @binding(1) var<storage, read> mat: array<dtype>;
@@ -66,14 +70,24 @@ fn gemv(if ($enable_subgroups) {
   }
   mat_offset += out_row * mat_row_stride;
 
+  // The range of cols worked on.
+  if ($split_k) {
+    let split_count = (mat_cols + split_size - 1) / split_size;
+    let k_begin = tid.y * split_size;
+    let k_end = min(k_begin + split_size, mat_cols);
+  } else {
+    let k_begin = 0u;
+    let k_end = mat_cols;
+  }
+
   // Per-thread result and intermediates.
   var result: array<dtype, row_work_per_thread>;
   var coefficient: array<dtype, col_work_per_thread>;
   var intermediate: array<dtype, col_work_per_thread>;
 
   // Loop over vector.
-  for (var block = 0u; block < mat_cols / block_size_col; block++) {
-    let col = lid.x * col_work_per_thread + block * block_size_col;
+  for (var block = 0u; block < (k_end - k_begin) / block_size_col; block++) {
+    let col = k_begin + lid.x * col_work_per_thread + block * block_size_col;
     // Load vector.
     load_unsafe(&coefficient, &vec, vec_offset + col);
 
@@ -94,17 +108,17 @@ fn gemv(if ($enable_subgroups) {
   }
 
   // Leftover in cols.
-  let leftover = mat_cols % block_size_col;
+  let leftover = (k_end - k_begin) % block_size_col;
   if (leftover != 0) {
-    let col = (mat_cols - leftover) + lid.x * col_work_per_thread;
+    let col = (k_end - leftover) + lid.x * col_work_per_thread;
     load_safe(&coefficient,
               &vec,
-              vec_offset + mat_cols,
+              vec_offset + k_end,
               vec_offset + col);
     for (var r = 0u; r < row_work_per_thread; r++) {
       load_safe(&intermediate,
                 &mat,
-                mat_offset + r * mat_row_stride + mat_cols,
+                mat_offset + r * mat_row_stride + k_end,
                 mat_offset + r * mat_row_stride + col);
       for (var c = 0u; c < col_work_per_thread; c++) {
         if ($dtype_is_floating) {
@@ -172,12 +186,18 @@ fn gemv(if ($enable_subgroups) {
   }
   for (var r = 0u; r < row_work_per_thread; r++) {
     if (out_row + r < mat_rows) {
+      if ($split_k) {
+        let out_idx = (out_offset + r) * split_count + tid.y;
+      } else {
+        let out_idx = out_offset + r;
+      }
       if ($enable_subgroups) {
-        out[out_offset + r] = result[r];
+        let value = result[r];
       } else {
         let idx = (lid.y * row_work_per_thread + r) * workgroup_result_cols;
-        out[out_offset + r] = workgroup_result[idx];
+        let value = workgroup_result[idx];
       }
+      out[out_idx] = apply_epilogue(value, out_idx, out_row + r);
     }
   }
 }
@@ -199,4 +219,5 @@ fn load_safe(dst: ptr<function, array<dtype, col_work_per_thread>>,
   }
 }
 
+// include epilogue.wgsl
 // include utils.wgsl
@@ -24,6 +24,10 @@ const group_cols: u32 = $group_cols;
 const group_size: u32 = group_rows * group_cols;
 const rows_per_workgroup = row_work_per_thread * group_rows;
 const cols_per_workgroup = col_work_per_thread * group_cols * group_count;
+if ($split_k) {
+  // Each workgroup works on split_size rows, and writes partial results.
+  const split_size: u32 = $split_size;
+}
 
 @group(0) @binding(0) var<storage, read_write> out: array<dtype>;
 @group(0) @binding(1) var<storage, read> mat: array<dtype>;
@@ -63,14 +67,24 @@ fn gemvt(@builtin(workgroup_id) tid: vec3<u32>,
     let vec_offset = coord_to_index(tid.z, &batch_shape, &batch_strides_vec);
   }
 
+  // The range of rows worked on.
+  if ($split_k) {
+    let split_count = (mat_rows + split_size - 1) / split_size;
+    let k_begin = tid.y * split_size;
+    let k_end = min(k_begin + split_size, mat_rows);
+  } else {
+    let k_begin = 0u;
+    let k_end = mat_rows;
+  }
+
   // Per-thread result and intermediates.
   var result: array<dtype, col_work_per_thread>;
   var coefficient: array<dtype, row_work_per_thread>;
   var intermediate: array<dtype, col_work_per_thread>;
 
   // Loop over vector.
-  for (var block = 0u; block < mat_rows / rows_per_workgroup; block++) {
-    let row = block * rows_per_workgroup + row_in_workgroup * row_work_per_thread;
+  for (var block = 0u; block < (k_end - k_begin) / rows_per_workgroup; block++) {
+    let row = k_begin + block * rows_per_workgroup + row_in_workgroup * row_work_per_thread;
     // Load vector.
     for (var r = 0u; r < row_work_per_thread; r++) {
       coefficient[r] = vec[vec_offset + row + r];
@@ -95,10 +109,10 @@ fn gemvt(@builtin(workgroup_id) tid: vec3<u32>,
   }
 
   // Leftover in rows.
-  let leftover = mat_rows % rows_per_workgroup;
+  let leftover = (k_end - k_begin) % rows_per_workgroup;
   if (leftover != 0) {
-    let row = mat_rows - leftover + row_in_workgroup * row_work_per_thread;
-    for (var r = 0u; r < row_work_per_thread && row + r < mat_rows; r++) {
+    let row = k_end - leftover + row_in_workgroup * row_work_per_thread;
+    for (var r = 0u; r < row_work_per_thread && row + r < k_end; r++) {
       coefficient[r] = vec[vec_offset + row + r];
       for (var c = 0u; c < col_work_per_thread && out_col + c < mat_cols; c++) {
         intermediate[c] = mat[mat_offset + (row + r) * mat_row_stride + out_col + c];
@@ -150,14 +164,21 @@ fn gemvt(@builtin(workgroup_id) tid: vec3<u32>,
   }
   for (var c = 0u; c < col_work_per_thread; c++) {
     if (out_col + c < mat_cols) {
+      if ($split_k) {
+        let out_idx = (out_offset + c) * split_count + tid.y;
+      } else {
+        let out_idx = out_offset + c;
+      }
       if ($enable_subgroups) {
-        out[out_offset + c] = result[c];
+        let value = result[c];
       } else {
         let idx = col_in_workgroup * col_work_per_thread + c;
-        out[out_offset + c] = workgroup_result[idx];
+        let value = workgroup_result[idx];
       }
+      out[out_idx] = apply_epilogue(value, out_idx, out_col + c);
     }
   }
 }
 
+// include epilogue.wgsl
 // include utils.wgsl
@@ -0,0 +1,122 @@
+if ($enable_f16) {
+  enable f16;
+}
+if ($enable_subgroups) {
+  enable subgroups;
+}
+if ($enable_subgroups_f16) {
+  enable subgroups_f16;
+}
+
+alias dtype = $dtype;
+
+// Each row of the quantized matrix is packed as a little-endian bitstream of
+// u32 words, and each group_size elements of a row share the same scale and
+// bias.
+const bits: u32 = $bits;
+const group_size: u32 = $group_size;
+
+// Each thread computes (row_work_per_thread * col_work_per_thread) elements of
+// output, which are strided by the workgroup size so writes are coalesced.
+const row_work_per_thread: u32 = 4;
+const col_work_per_thread: u32 = 4;
+const workgroup_size_row: u32 = 16;
+const workgroup_size_col: u32 = 16;
+const workgroup_size = workgroup_size_row * workgroup_size_col;
+// Each workgroup computes a (tile_rows * tile_cols) tile of output, by walking
+// through the inner dimension in steps of tile_k. The quantized matrix is
+// dequantized into b_tile once and then used by all the tile_rows rows.
+const tile_rows = workgroup_size_row * row_work_per_thread;
+const tile_cols = workgroup_size_col * col_work_per_thread;
+const tile_k: u32 = 16;
+
+@group(0) @binding(0) var<storage, read_write> out: array<dtype>;
+@group(0) @binding(1) var<storage, read> a: array<dtype>;
+@group(0) @binding(2) var<storage, read> mat: array<u32>;
+@group(0) @binding(3) var<storage, read> scales: array<dtype>;
+@group(0) @binding(4) var<storage, read> biases: array<dtype>;
+@group(0) @binding(5) var<uniform> m_size: u32;
+@group(0) @binding(6) var<uniform> n_size: u32;
+@group(0) @binding(7) var<uniform> k_size: u32;
+
+@compute @workgroup_size(workgroup_size_col, workgroup_size_row)
+fn qgemm(if ($enable_subgroups) {
+           @builtin(subgroup_size) subgroup_size: u32,
+           @builtin(subgroup_invocation_id) subgroup_lane: u32,
+         }
+         @builtin(workgroup_id) tid: vec3<u32>,
+         @builtin(local_invocation_id) lid: vec3<u32>,
+         @builtin(local_invocation_index) index: u32) {
+  let tile_row = tid.y * tile_rows;
+  let tile_col = tid.x * tile_cols;
+
+  // The quantized matrix is [k_size, n_size] when transposed, otherwise it is
+  // [n_size, k_size], and its cols are always a multiple of 32.
+  if ($mat_transposed) {
+    let mat_cols = n_size;
+  } else {
+    let mat_cols = k_size;
+  }
+  let row_words = mat_cols * bits / 32;
+  let groups_per_row = mat_cols / group_size;
+
+  if ($enable_subgroups) {
+    let share_a = rows_in_subgroups(subgroup_size, subgroup_lane, lid);
+    let row_lane = subgroup_lane - lid.x;
+  }
+
+  // Per-thread results.
+  var result: array<array<dtype, col_work_per_thread>, row_work_per_thread>;
+
+  for (var k_start = 0u; k_start < k_size; k_start += tile_k) {
+    load_a_tile(index, tile_row, k_start, k_size, 0, k_size);
+
+    // Dequantize tile of b, reading along the packed dimension.
+    for (var j = 0u; j < col_work_per_thread; j++) {
+      let idx = index + j * workgroup_size;
+      if ($mat_transposed) {
+        let c = idx % tile_cols;
+        let k = idx / tile_cols;
+        let mat_row = k_start + k;
+        let mat_col = tile_col + c;
+      } else {
+        let c = idx / tile_k;
+        let k = idx % tile_k;
+        let mat_row = tile_col + c;
+        let mat_col = k_start + k;
+      }
+      var value: dtype = 0;
+      if (tile_col + c < n_size && k_start + k < k_size) {
+        let q = load_quantized(mat_row * row_words, mat_col * bits);
+        let group = mat_row * groups_per_row + mat_col / group_size;
+        value = fma(dtype(q), scales[group], biases[group]);
+      }
+      b_tile[k * tile_cols + c] = value;
+    }
+    workgroupBarrier();
+
+    if ($enable_subgroups) {
+      multiply_tiles(&result, lid, share_a, row_lane);
+    } else {
+      multiply_tiles(&result, lid);
+    }
+    workgroupBarrier();
+  }
+
+  // Write output.
+  for (var i = 0u; i < row_work_per_thread; i++) {
+    let row = tile_row + lid.y + i * workgroup_size_row;
+    if (row >= m_size) {
+      break;
+    }
+    for (var j = 0u; j < col_work_per_thread; j++) {
+      let col = tile_col + lid.x + j * workgroup_size_col;
+      if (col < n_size) {
+        out[row * n_size + col] = result[i][j];
+      }
+    }
+  }
+}
+
+// include gemm_ops.wgsl
+// include quantized_ops.wgsl
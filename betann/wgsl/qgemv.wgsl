@@ -0,0 +1,161 @@
+if ($enable_f16) {
+  enable f16;
+}
+if ($enable_subgroups) {
+  enable subgroups;
+}
+if ($enable_subgroups_f16) {
+  enable subgroups_f16;
+}
+
+alias dtype = $dtype;
+
+// Each row of the matrix is packed as a little-endian bitstream of u32 words,
+// and each group_size elements of a row share the same scale and bias.
+const bits: u32 = $bits;
+const group_size: u32 = $group_size;
+
+// Workload per thread.
+const row_work_per_thread: u32 = $row_work_per_thread;
+// The columns worked on by a thread are always in the same group.
+const col_work_per_thread: u32 = 8;
+// Each workgroup works on (workgroup_size_row * row_work_per_thread) rows and all
+// columns.
+const workgroup_size_row: u32 = $group_count;
+const workgroup_size_col: u32 = 32;
+
+@group(0) @binding(0) var<storage, read_write> out: array<dtype>;
+@group(0) @binding(1) var<storage, read> mat: array<u32>;
+@group(0) @binding(2) var<storage, read> scales: array<dtype>;
+@group(0) @binding(3) var<storage, read> biases: array<dtype>;
+@group(0) @binding(4) var<uniform> mat_rows: u32;
+@group(0) @binding(5) var<uniform> mat_cols: u32;
+@group(0) @binding(6) var<storage, read> vec: array<dtype>;
+
+if ($enable_subgroups) {
+  // When enable_subgroups we only need results from each subgroup, however
+  // as we don't know the subgroup_size we have to assume minimum size.
+  const workgroup_result_cols = workgroup_size_col / $subgroup_min_size;
+} else {
+  const workgroup_result_cols = workgroup_size_col;
+}
+// The workgroup_result collects results from each thread.
+var<workgroup> workgroup_result: array<dtype, workgroup_size_row *
+                                              row_work_per_thread *
+                                              workgroup_result_cols>;
+
+@compute @workgroup_size(workgroup_size_col, workgroup_size_row)
+fn qgemv(if ($enable_subgroups) {
+           @builtin(subgroup_size) subgroup_size: u32,
+         }
+         @builtin(workgroup_id) tid: vec3<u32>,
+         @builtin(local_invocation_id) lid: vec3<u32>) {
+  const block_size_row = row_work_per_thread * workgroup_size_row;
+  const block_size_col = col_work_per_thread * workgroup_size_col;
+
+  // The row worked on.
+  let out_row = tid.x * block_size_row + lid.y * row_work_per_thread;
+
+  // Offset of current batch.
+  let out_offset = tid.z * mat_rows + out_row;
+  let vec_offset = tid.z * mat_cols;
+
+  // The mat_cols is always a multiple of 32 so rows are aligned to words.
+  let row_words = mat_cols * bits / 32;
+  let groups_per_row = mat_cols / group_size;
+
+  // Per-thread result and intermediates.
+  var result: array<dtype, row_work_per_thread>;
+  var coefficient: array<dtype, col_work_per_thread>;
+
+  // Loop over vector.
+  for (var col = lid.x * col_work_per_thread; col < mat_cols; col += block_size_col) {
+    // Load vector, the sum is used for applying biases.
+    var vec_sum: dtype = 0;
+    for (var c = 0u; c < col_work_per_thread; c++) {
+      coefficient[c] = vec[vec_offset + col + c];
+      vec_sum += coefficient[c];
+    }
+
+    // Work.
+    for (var r = 0u; r < row_work_per_thread && out_row + r < mat_rows; r++) {
+      let row = out_row + r;
+      // Multiply with the quantized values, and then apply the group's scale
+      // and bias to the sum.
+      var sum: dtype = 0;
+      for (var c = 0u; c < col_work_per_thread; c++) {
+        let q = load_quantized(row * row_words, (col + c) * bits);
+        sum = fma(dtype(q), coefficient[c], sum);
+      }
+      let group = row * groups_per_row + col / group_size;
+      result[r] += scales[group] * sum + biases[group] * vec_sum;
+    }
+  }
+
+  if ($enable_subgroups) {
+    // Subgroup accumulations.
+    for (var r = 0u; r < row_work_per_thread; r++) {
+      if (subgroup_size <= workgroup_size_col) {
+        result[r] = subgroupAdd(result[r]);
+      } else {
+        for (var delta = workgroup_size_col / 2; delta >= 1; delta >>= 1) {
+          result[r] += subgroupShuffleDown(result[r], delta);
+        }
+      }
+    }
+
+    // Workgroup accumulations.
+    for (var delta = workgroup_size_col / subgroup_size; delta > 1; delta /= subgroup_size) {
+      // Write first lane's result to shared memory.
+      if (lid.x % subgroup_size == 0) {
+        for (var r = 0u; r < row_work_per_thread; r++) {
+          let idx = (lid.y * row_work_per_thread + r) * workgroup_result_cols;
+          workgroup_result[idx + lid.x / subgroup_size] = result[r];
+        }
+      }
+
+      // Subgroup accumulations.
+      workgroupBarrier();
+      for (var r = 0u; r < row_work_per_thread; r++) {
+        let idx = (lid.y * row_work_per_thread + r) * workgroup_result_cols;
+        result[r] = select(0, workgroup_result[idx + lid.x], lid.x < delta);
+        result[r] = subgroupAdd(result[r]);
+      }
+    }
+  } else {
+    // Write to shared memory.
+    for (var r = 0u; r < row_work_per_thread; r++) {
+      let idx = (lid.y * row_work_per_thread + r) * workgroup_size_col + lid.x;
+      workgroup_result[idx] = result[r];
+    }
+
+    // Workgroup accumulations.
+    workgroupBarrier();
+    for (var r = 0u; r < row_work_per_thread; r++) {
+      let idx = (lid.y * row_work_per_thread + r) * workgroup_size_col + lid.x;
+      for (var delta = workgroup_size_col / 2; delta >= 1; delta >>= 1) {
+        if (lid.x < delta) {
+          workgroup_result[idx] += workgroup_result[idx + delta];
+        }
+        workgroupBarrier();
+      }
+    }
+  }
+
+  // Write output.
+  if (lid.x != 0 || out_row >= mat_rows) {
+    return;
+  }
+  for (var r = 0u; r < row_work_per_thread; r++) {
+    if (out_row + r < mat_rows) {
+      if ($enable_subgroups) {
+        out[out_offset + r] = result[r];
+      } else {
+        let idx = (lid.y * row_work_per_thread + r) * workgroup_result_cols;
+        out[out_offset + r] = workgroup_result[idx];
+      }
+    }
+  }
+}
+
+// include quantized_ops.wgsl
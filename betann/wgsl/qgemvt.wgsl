@@ -0,0 +1,133 @@
+if ($enable_f16) {
+  enable f16;
+}
+if ($enable_subgroups) {
+  enable subgroups;
+}
+if ($enable_subgroups_f16) {
+  enable subgroups_f16;
+}
+
+alias dtype = $dtype;
+
+// Each row of the matrix is packed as a little-endian bitstream of u32 words,
+// and each group_size elements of a row share the same scale and bias.
+const bits: u32 = $bits;
+const group_size: u32 = $group_size;
+
+// Workload per thread.
+const row_work_per_thread: u32 = $row_work_per_thread;
+// The columns worked on by a thread are always in the same group.
+const col_work_per_thread: u32 = 8;
+// A group consists one (on mac) or more subgroups, and a workgroup consists of
+// group_count of groups.
+// Each workgroup works on (group_cols * group_count) cols, and all rows.
+// Each thread works on (mat_cols / group_rows) rows.
+const group_count: u32 = $group_count;
+const group_rows: u32 = $group_rows;
+const group_cols: u32 = $group_cols;
+
+const group_size_threads: u32 = group_rows * group_cols;
+const rows_per_workgroup = row_work_per_thread * group_rows;
+const cols_per_workgroup = col_work_per_thread * group_cols * group_count;
+
+@group(0) @binding(0) var<storage, read_write> out: array<dtype>;
+@group(0) @binding(1) var<storage, read> mat: array<u32>;
+@group(0) @binding(2) var<storage, read> scales: array<dtype>;
+@group(0) @binding(3) var<storage, read> biases: array<dtype>;
+@group(0) @binding(4) var<uniform> mat_rows: u32;
+@group(0) @binding(5) var<uniform> mat_cols: u32;
+@group(0) @binding(6) var<storage, read> vec: array<dtype>;
+
+if (!$enable_subgroups) {
+  var<workgroup> workgroup_result: array<dtype, group_rows * cols_per_workgroup>;
+}
+
+@compute @workgroup_size(group_size_threads, group_count)
+fn qgemvt(@builtin(workgroup_id) tid: vec3<u32>,
+          @builtin(local_invocation_id) lid: vec3<u32>) {
+  // Position in the group and workgroup.
+  let row_in_group = lid.x / group_cols;
+  let col_in_group = lid.x % group_cols;
+  let row_in_workgroup = row_in_group;
+  let col_in_workgroup = lid.y * group_cols + col_in_group;
+
+  // The col worked on.
+  let out_col = tid.x * cols_per_workgroup + col_in_workgroup * col_work_per_thread;
+
+  // Offset of current batch.
+  let out_offset = tid.z * mat_cols + out_col;
+  let vec_offset = tid.z * mat_rows;
+
+  // The mat_cols is always a multiple of 32 so rows are aligned to words.
+  let row_words = mat_cols * bits / 32;
+  let groups_per_row = mat_cols / group_size;
+
+  // Per-thread result.
+  var result: array<dtype, col_work_per_thread>;
+
+  // Loop over vector, the mat_cols is always a multiple of col_work_per_thread
+  // so the cols of a thread are either all valid or all out of bounds.
+  if (out_col < mat_cols) {
+    for (var row = row_in_workgroup * row_work_per_thread; row < mat_rows; row += rows_per_workgroup) {
+      for (var r = 0u; r < row_work_per_thread && row + r < mat_rows; r++) {
+        // Apply the vector to the group's scale and bias, so each element only
+        // needs one fma.
+        let coefficient = vec[vec_offset + row + r];
+        let group = (row + r) * groups_per_row + out_col / group_size;
+        let scale = coefficient * scales[group];
+        let bias = coefficient * biases[group];
+        for (var c = 0u; c < col_work_per_thread; c++) {
+          let q = load_quantized((row + r) * row_words, (out_col + c) * bits);
+          result[c] += fma(dtype(q), scale, bias);
+        }
+      }
+    }
+  }
+
+  if ($enable_subgroups) {
+    // Subgroup accumulations.
+    for (var c = 0u; c < col_work_per_thread; c++) {
+      for (var delta = group_rows / 2; delta >= 1; delta >>= 1) {
+        result[c] += subgroupShuffleDown(result[c], delta * group_cols);
+      }
+    }
+  } else {
+    // Write to shared memory.
+    for (var c = 0u; c < col_work_per_thread; c++) {
+      let idx = row_in_workgroup * cols_per_workgroup +
+                col_in_workgroup * col_work_per_thread +
+                c;
+      workgroup_result[idx] = result[c];
+    }
+
+    // Workgroup accumulations.
+    workgroupBarrier();
+    for (var c = 0u; c < col_work_per_thread; c++) {
+      let idx = row_in_workgroup * cols_per_workgroup +
+                col_in_workgroup * col_work_per_thread +
+                c;
+      for (var delta = group_rows / 2; delta >= 1; delta >>= 1) {
+        if (row_in_group < delta) {
+          workgroup_result[idx] += workgroup_result[idx + delta * cols_per_workgroup];
+        }
+        workgroupBarrier();
+      }
+    }
+  }
+
+  // Write output.
+  if (row_in_workgroup != 0 || out_col >= mat_cols) {
+    return;
+  }
+  for (var c = 0u; c < col_work_per_thread; c++) {
+    if ($enable_subgroups) {
+      out[out_offset + c] = result[c];
+    } else {
+      let idx = col_in_workgroup * col_work_per_thread + c;
+      out[out_offset + c] = workgroup_result[idx];
+    }
+  }
+}
+
+// include quantized_ops.wgsl
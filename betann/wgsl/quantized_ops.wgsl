@@ -0,0 +1,11 @@
+// Read the quantized value starting at |bit| of the row at |offset|, which may
+// span two words when bits is not a power of 2.
+fn load_quantized(offset: u32, bit: u32) -> u32 {
+  let word = offset + bit / 32;
+  let shift = bit % 32;
+  var value = mat[word] >> shift;
+  if (shift + bits > 32) {
+    value |= mat[word + 1] << (32 - shift);
+  }
+  return value & ((1u << bits) - 1);
+}
@@ -0,0 +1,47 @@
+if ($enable_f16) {
+  enable f16;
+}
+
+alias dtype = $dtype;
+
+@group(0) @binding(0) var<storage, read_write> histograms: array<u32>;
+@group(0) @binding(1) var<uniform> size_sorted_axis: u32;
+@group(0) @binding(2) var<uniform> shift: u32;
+if ($first_pass) {
+  @group(0) @binding(3) var<storage, read> keys_in: array<dtype>;
+} else {
+  @group(0) @binding(3) var<storage, read> keys_in: array<u32>;
+}
+
+var<workgroup> workgroup_counts: array<atomic<u32>, radix>;
+
+// Count the digits of keys in each tile. The counts are written as
+// [rows, radix, num_tiles], so their exclusive scan gives where the keys of
+// each digit in each tile start in the sorted row.
+@compute @workgroup_size(num_threads, 1, 1)
+fn radix_count(@builtin(workgroup_id) tid: vec3<u32>,
+               @builtin(local_invocation_id) lid: vec3<u32>,
+               @builtin(num_workgroups) num_workgroups: vec3<u32>) {
+  if (lid.x < radix) {
+    atomicStore(&workgroup_counts[lid.x], 0);
+  }
+  workgroupBarrier();
+
+  let row_offset = tid.y * size_sorted_axis;
+  let tile_start = tid.x * tile_size;
+  for (var i = lid.x; i < tile_size; i += num_threads) {
+    if (tile_start + i < size_sorted_axis) {
+      let digit = get_digit(load_bits(row_offset + tile_start + i));
+      atomicAdd(&workgroup_counts[digit], 1);
+    }
+  }
+  workgroupBarrier();
+
+  if (lid.x < radix) {
+    let idx = (tid.y * radix + lid.x) * num_workgroups.x + tid.x;
+    histograms[idx] = atomicLoad(&workgroup_counts[lid.x]);
+  }
+}
+
+// include radix_ops.wgsl
+// include radix_keys.wgsl
@@ -0,0 +1,40 @@
+// The keys are mapped to unsigned bits that have the same order.
+const key_bits: u32 = $key_bits;
+const key_mask: u32 = 0xffffffffu >> (32 - key_bits);
+const sign_bit: u32 = 1u << (key_bits - 1);
+
+fn key_to_bits(key: dtype) -> u32 {
+  if ($key_is_f16) {
+    let bits = bitcast<u32>(vec2<dtype>(key, 0)) & key_mask;
+  } else {
+    let bits = bitcast<u32>(key);
+  }
+  if ($key_is_float) {
+    // Flip all bits of negative numbers, and the sign bit of the others.
+    let mask = select(sign_bit, key_mask, (bits & sign_bit) != 0);
+  } else {
+    if ($key_is_signed) {
+      let mask = sign_bit;
+    } else {
+      let mask = 0u;
+    }
+  }
+  return bits ^ mask;
+}
+
+fn bits_to_key(bits: u32) -> dtype {
+  if ($key_is_float) {
+    let mask = select(key_mask, sign_bit, (bits & sign_bit) != 0);
+  } else {
+    if ($key_is_signed) {
+      let mask = sign_bit;
+    } else {
+      let mask = 0u;
+    }
+  }
+  if ($key_is_f16) {
+    return bitcast<vec2<dtype>>(bits ^ mask)[0];
+  } else {
+    return bitcast<dtype>(bits ^ mask);
+  }
+}
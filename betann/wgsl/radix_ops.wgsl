@@ -0,0 +1,39 @@
+// Keys are sorted by one digit of radix_bits per pass, and each workgroup works
+// on a tile of tile_size keys.
+const radix_bits: u32 = $radix_bits;
+const radix: u32 = 1 << radix_bits;
+const num_threads: u32 = $num_threads;
+const work_per_thread: u32 = $work_per_thread;
+const tile_size = num_threads * work_per_thread;
+
+var<workgroup> workgroup_sums: array<u32, num_threads>;
+
+// Return the sum of values of all previous threads in workgroup.
+fn workgroup_exclusive_scan(value: u32, lid: u32) -> u32 {
+  workgroup_sums[lid] = value;
+  workgroupBarrier();
+  for (var delta: u32 = 1; delta < num_threads; delta <<= 1) {
+    var sum = workgroup_sums[lid];
+    if (lid >= delta) {
+      sum += workgroup_sums[lid - delta];
+    }
+    workgroupBarrier();
+    workgroup_sums[lid] = sum;
+    workgroupBarrier();
+  }
+  return workgroup_sums[lid] - value;
+}
+
+if ($has_keys) {
+  fn load_bits(idx: u32) -> u32 {
+    if ($first_pass) {
+      return key_to_bits(keys_in[idx]);
+    } else {
+      return keys_in[idx];
+    }
+  }
+
+  fn get_digit(bits: u32) -> u32 {
+    return (bits >> shift) & (radix - 1);
+  }
+}
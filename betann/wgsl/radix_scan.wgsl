@@ -0,0 +1,28 @@
+@group(0) @binding(0) var<storage, read_write> histograms: array<u32>;
+@group(0) @binding(1) var<uniform> num_tiles: u32;
+
+// Exclusive scan of the digit counts of each row, which are laid out as
+// [radix, num_tiles], and each thread scans a contiguous chunk of them.
+@compute @workgroup_size(num_threads, 1, 1)
+fn radix_scan(@builtin(workgroup_id) tid: vec3<u32>,
+              @builtin(local_invocation_id) lid: vec3<u32>) {
+  let size = radix * num_tiles;
+  let offset = tid.y * size;
+  let chunk = (size + num_threads - 1) / num_threads;
+  let start = min(size, lid.x * chunk);
+  let end = min(size, start + chunk);
+
+  var sum: u32 = 0;
+  for (var i = start; i < end; i++) {
+    sum += histograms[offset + i];
+  }
+
+  var running = workgroup_exclusive_scan(sum, lid.x);
+  for (var i = start; i < end; i++) {
+    let count = histograms[offset + i];
+    histograms[offset + i] = running;
+    running += count;
+  }
+}
+
+// include radix_ops.wgsl
@@ -0,0 +1,115 @@
+if ($enable_f16) {
+  enable f16;
+}
+
+alias dtype = $dtype;
+
+// The keys are stored as ordered bits in temporary buffers, until the last pass
+// writes sorted values or indices to output.
+if ($last_pass) {
+  if ($argsort) {
+    @group(0) @binding(0) var<storage, read_write> out: array<u32>;
+  } else {
+    @group(0) @binding(0) var<storage, read_write> out: array<dtype>;
+  }
+} else {
+  @group(0) @binding(0) var<storage, read_write> keys_out: array<u32>;
+}
+@group(0) @binding(1) var<uniform> size_sorted_axis: u32;
+@group(0) @binding(2) var<uniform> shift: u32;
+if ($first_pass) {
+  @group(0) @binding(3) var<storage, read> keys_in: array<dtype>;
+} else {
+  @group(0) @binding(3) var<storage, read> keys_in: array<u32>;
+}
+@group(0) @binding(4) var<storage, read> histograms: array<u32>;
+if ($argsort) {
+  if (!$last_pass) {
+    @group(0) @binding($idxs_out_binding) var<storage, read_write> idxs_out: array<u32>;
+  }
+  if (!$first_pass) {
+    @group(0) @binding($idxs_in_binding) var<storage, read> idxs_in: array<u32>;
+  }
+}
+
+var<workgroup> workgroup_counts: array<u32, radix * num_threads>;
+
+// Scatter keys of each tile to their places sorted by current digit, each
+// thread works on contiguous keys so keys of the same digit keep their order.
+@compute @workgroup_size(num_threads, 1, 1)
+fn radix_scatter(@builtin(workgroup_id) tid: vec3<u32>,
+                 @builtin(local_invocation_id) lid: vec3<u32>,
+                 @builtin(num_workgroups) num_workgroups: vec3<u32>) {
+  let row_offset = tid.y * size_sorted_axis;
+  let start = tid.x * tile_size + lid.x * work_per_thread;
+
+  // Count the digits of current thread's keys.
+  var bits: array<u32, work_per_thread>;
+  var counts: array<u32, radix>;
+  for (var i: u32 = 0; i < work_per_thread; i++) {
+    if (start + i < size_sorted_axis) {
+      bits[i] = load_bits(row_offset + start + i);
+      counts[get_digit(bits[i])] += 1;
+    }
+  }
+  for (var d: u32 = 0; d < radix; d++) {
+    workgroup_counts[d * num_threads + lid.x] = counts[d];
+  }
+  workgroupBarrier();
+
+  // Scan the counts ordered by digit and then thread, which gives the number
+  // of keys in tile that go before current thread's keys of each digit.
+  let chunk_start = lid.x * radix;
+  var sum: u32 = 0;
+  for (var j: u32 = 0; j < radix; j++) {
+    sum += workgroup_counts[chunk_start + j];
+  }
+  var running = workgroup_exclusive_scan(sum, lid.x);
+  for (var j: u32 = 0; j < radix; j++) {
+    let count = workgroup_counts[chunk_start + j];
+    workgroup_counts[chunk_start + j] = running;
+    running += count;
+  }
+  workgroupBarrier();
+
+  // Where current thread's keys of each digit start in the sorted row.
+  for (var d: u32 = 0; d < radix; d++) {
+    let tile_offset = histograms[(tid.y * radix + d) * num_workgroups.x + tid.x];
+    counts[d] = tile_offset +
+                workgroup_counts[d * num_threads + lid.x] -
+                workgroup_counts[d * num_threads];
+  }
+
+  // Write output.
+  for (var i: u32 = 0; i < work_per_thread; i++) {
+    let idx = start + i;
+    if (idx >= size_sorted_axis) {
+      break;
+    }
+    let digit = get_digit(bits[i]);
+    let pos = row_offset + counts[digit];
+    counts[digit] += 1;
+    if ($argsort) {
+      if ($first_pass) {
+        let payload = idx;
+      } else {
+        let payload = idxs_in[row_offset + idx];
+      }
+      if ($last_pass) {
+        out[pos] = payload;
+      } else {
+        keys_out[pos] = bits[i];
+        idxs_out[pos] = payload;
+      }
+    } else {
+      if ($last_pass) {
+        out[pos] = bits_to_key(bits[i]);
+      } else {
+        keys_out[pos] = bits[i];
+      }
+    }
+  }
+}
+
+// include radix_ops.wgsl
+// include radix_keys.wgsl
@@ -14,14 +14,27 @@ alias input_dtype = $input_dtype;
 const workgroup_size: u32 = $workgroup_size;
 const work_per_thread: u32 = 4;
 
-@group(0) @binding(0) var<storage, read_write> output: array<output_dtype>;
-@group(0) @binding(1) var<storage, read> input: array<input_dtype>;
+if ($write_partials) {
+  // The partial results of rows, which are reduced by the 2nd pass.
+  @group(0) @binding(0) var<storage, read_write> partials: array<reduce_total>;
+} else {
+  @group(0) @binding(0) var<storage, read_write> output: array<output_dtype>;
+}
+if ($read_partials) {
+  // The partial results written by the 1st pass.
+  @group(0) @binding(1) var<storage, read> input_partials: array<reduce_total>;
+} else {
+  @group(0) @binding(1) var<storage, read> input: array<input_dtype>;
+}
 @group(0) @binding(2) var<uniform> row_size: u32;
+if ($write_values) {
+  @group(0) @binding(3) var<storage, read_write> output_values: array<values_dtype>;
+}
 
 if ($enable_subgroups) {
-  var<workgroup> workgroup_totals: array<output_dtype, workgroup_size / $subgroup_min_size>;
+  var<workgroup> workgroup_totals: array<reduce_total, workgroup_size / $subgroup_min_size>;
 } else {
-  var<workgroup> workgroup_totals: array<output_dtype, workgroup_size>;
+  var<workgroup> workgroup_totals: array<reduce_total, workgroup_size>;
 }
 
 @compute @workgroup_size(workgroup_size, 1, 1)
@@ -31,17 +44,24 @@ fn reduce_all_$op(if ($enable_subgroups) {
                   }
                   @builtin(global_invocation_id) gid: vec3<u32>,
                   @builtin(local_invocation_id) lid: vec3<u32>) {
-  // How much work to do.
-  let input_size = arrayLength(&input);
-  let row = gid.y * row_size;
-  let current_row_size = select(
-      row_size,
-      select(0, input_size - row, input_size > row),
-      row + row_size > input_size);
-
-  // Reduce current row.
   var total = get_initial_value_$op();
-  row_reduce(&total, lid.x, &input, row, current_row_size, workgroup_size, work_per_thread);
+  if ($read_partials) {
+    // Reduce the partial results of all rows.
+    for (var i = lid.x; i < row_size; i += workgroup_size) {
+      total = reduce_op_$op(input_partials[i], total);
+    }
+  } else {
+    // How much work to do.
+    let input_size = arrayLength(&input);
+    let row = gid.y * row_size;
+    let current_row_size = select(
+        row_size,
+        select(0, input_size - row, input_size > row),
+        row + row_size > input_size);
+
+    // Reduce current row.
+    row_reduce(&total, lid.x, &input, row, row, current_row_size, workgroup_size, work_per_thread);
+  }
 
   // Reduce across the workgroup.
   if ($enable_subgroups) {
@@ -52,7 +72,14 @@ fn reduce_all_$op(if ($enable_subgroups) {
 
   // Write output.
   if (lid.x == 0) {
-    output[gid.y] = total;
+    if ($write_partials) {
+      partials[gid.y] = total;
+    } else {
+      output[gid.y] = total_to_output(total);
+      if ($write_values) {
+        output_values[gid.y] = total_to_values(total);
+      }
+    }
   }
 }
 
@@ -0,0 +1,74 @@
+if ($enable_f16) {
+  enable f16;
+}
+if ($enable_subgroups) {
+  enable subgroups;
+}
+if ($enable_subgroups_f16) {
+  enable subgroups_f16;
+}
+
+alias output_dtype = $output_dtype;
+alias input_dtype = $input_dtype;
+
+// Each workgroup works on a strip of workgroup_size_col outputs, whose inputs
+// are contiguous, and the reductions are shared by workgroup_size_row threads.
+const workgroup_size_col: u32 = 32;
+const workgroup_size_row: u32 = $workgroup_size / workgroup_size_col;
+
+@group(0) @binding(0) var<storage, read_write> output: array<output_dtype>;
+@group(0) @binding(1) var<uniform> num_outputs: u32;
+@group(0) @binding(2) var<storage, read> input: array<input_dtype>;
+@group(0) @binding(3) var<uniform> num_reductions: u32;
+@group(0) @binding(4) var<uniform> split_size: u32;
+@group(0) @binding(5) var<storage, read> non_reduction_shape: array<u32>;
+@group(0) @binding(6) var<storage, read> non_reduction_strides: array<u32>;
+@group(0) @binding(7) var<storage, read> reduction_shape: array<u32>;
+@group(0) @binding(8) var<storage, read> reduction_strides: array<u32>;
+
+var<workgroup> workgroup_totals: array<output_dtype, workgroup_size_row * workgroup_size_col>;
+
+// When the reductions are split among workgroups, the partial results are
+// written as [num_outputs, split_count]. The strips are laid out in x and z
+// dimensions when there are more than the limit of one dimension.
+@compute @workgroup_size(workgroup_size_col, workgroup_size_row, 1)
+fn reduce_col_$op(@builtin(workgroup_id) tid: vec3<u32>,
+                  @builtin(local_invocation_id) lid: vec3<u32>,
+                  @builtin(num_workgroups) num_workgroups: vec3<u32>) {
+  let strip = tid.x + tid.z * num_workgroups.x;
+  let out_idx = strip * workgroup_size_col + lid.x;
+
+  // The range of reductions worked on.
+  let r_begin = tid.y * split_size;
+  let r_end = min(r_begin + split_size, num_reductions);
+
+  // Reduce the column per thread.
+  var total = get_initial_value_$op();
+  if (out_idx < num_outputs) {
+    let input_offset = coord_to_index(out_idx, &non_reduction_shape, &non_reduction_strides);
+    for (var r = r_begin + lid.y; r < r_end; r += workgroup_size_row) {
+      let idx = input_offset + coord_to_index(r, &reduction_shape, &reduction_strides);
+      total = reduce_op_$op(input_to_total(load_input(&input, idx), r), total);
+    }
+  }
+
+  // Reduce across the rows of workgroup.
+  let idx = lid.y * workgroup_size_col + lid.x;
+  workgroup_totals[idx] = total;
+  workgroupBarrier();
+  for (var delta = workgroup_size_row / 2; delta >= 1; delta >>= 1) {
+    if (lid.y < delta) {
+      workgroup_totals[idx] = reduce_op_$op(workgroup_totals[idx],
+                                            workgroup_totals[idx + delta * workgroup_size_col]);
+    }
+    workgroupBarrier();
+  }
+
+  // Write output.
+  if (lid.y == 0 && out_idx < num_outputs) {
+    output[out_idx * num_workgroups.y + tid.y] = workgroup_totals[lid.x];
+  }
+}
+
+// include reduce_ops.wgsl
+// include utils.wgsl
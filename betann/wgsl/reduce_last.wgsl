@@ -19,13 +19,16 @@ const write_per_thread: u32 = 4;
 @group(0) @binding(1) var<uniform> num_outputs: u32;
 @group(0) @binding(2) var<storage, read> input: array<input_dtype>;
 @group(0) @binding(3) var<uniform> row_size: u32;
+if ($write_values) {
+  @group(0) @binding(4) var<storage, read_write> output_values: array<values_dtype>;
+}
 
 if ($enable_subgroups) {
   const workgroup_totals_size = rows_threads * write_per_thread / $subgroup_min_size;
 } else {
   const workgroup_totals_size = rows_threads * write_per_thread;
 }
-var<workgroup> workgroup_totals: array<output_dtype, workgroup_totals_size>;
+var<workgroup> workgroup_totals: array<reduce_total, workgroup_totals_size>;
 
 @compute @workgroup_size(rows_threads, 1, 1)
 fn reduce_last_$op(if ($enable_subgroups) {
@@ -36,7 +39,7 @@ fn reduce_last_$op(if ($enable_subgroups) {
                    @builtin(local_invocation_id) lid: vec3<u32>) {
   // Initialize accumulator registers.
   let initial_value = get_initial_value_$op();
-  var totals: array<output_dtype, write_per_thread>;
+  var totals: array<reduce_total, write_per_thread>;
   for (var w = 0u; w < write_per_thread; w++) {
     totals[w] = initial_value;
   }
@@ -44,7 +47,7 @@ fn reduce_last_$op(if ($enable_subgroups) {
   // Reduce rows per thread.
   let row = gid.y * write_per_thread;
   for (var w = 0u; w < write_per_thread && row + w < num_outputs; w++) {
-    row_reduce(&totals[w], lid.x, &input, (row + w) * row_size, row_size, rows_threads, read_per_thread);
+    row_reduce(&totals[w], lid.x, &input, (row + w) * row_size, 0, row_size, rows_threads, read_per_thread);
   }
 
   // Reduce across the workgroup.
@@ -59,7 +62,53 @@ fn reduce_last_$op(if ($enable_subgroups) {
   // Write output.
   if (lid.x == 0) {
     for (var w = 0u; w < write_per_thread && row + w < num_outputs; w++) {
-      output[row + w] = totals[w];
+      output[row + w] = total_to_output(totals[w]);
+      if ($write_values) {
+        output_values[row + w] = total_to_values(totals[w]);
+      }
+    }
+  }
+}
+
+if ($packed) {
+  // When rows are short, each row is reduced by row_threads threads, and each
+  // workgroup works on (rows_threads / row_threads) rows.
+  const row_threads: u32 = $row_threads;
+  const rows_per_workgroup = rows_threads / row_threads;
+
+  var<workgroup> packed_totals: array<reduce_total, rows_threads>;
+
+  @compute @workgroup_size(rows_threads, 1, 1)
+  fn reduce_last_packed_$op(@builtin(workgroup_id) tid: vec3<u32>,
+                            @builtin(local_invocation_id) lid: vec3<u32>,
+                            @builtin(num_workgroups) num_workgroups: vec3<u32>) {
+    let workgroup = tid.x + tid.y * num_workgroups.x;
+    let row = workgroup * rows_per_workgroup + lid.x / row_threads;
+    let lane = lid.x % row_threads;
+
+    // Reduce the row by its threads.
+    var total = get_initial_value_$op();
+    if (row < num_outputs) {
+      row_reduce(&total, lane, &input, row * row_size, 0, row_size, row_threads, read_per_thread);
+    }
+
+    // Reduce across the threads of row.
+    packed_totals[lid.x] = total;
+    workgroupBarrier();
+    for (var delta = row_threads / 2; delta >= 1; delta >>= 1) {
+      if (lane < delta) {
+        packed_totals[lid.x] = reduce_op_$op(packed_totals[lid.x],
+                                             packed_totals[lid.x + delta]);
+      }
+      workgroupBarrier();
+    }
+
+    // Write output.
+    if (lane == 0 && row < num_outputs) {
+      output[row] = total_to_output(packed_totals[lid.x]);
+      if ($write_values) {
+        output_values[row] = total_to_values(packed_totals[lid.x]);
+      }
     }
   }
 }
@@ -12,7 +12,7 @@ const workgroup_size: u32 = $workgroup_size;
 @compute @workgroup_size(workgroup_size, 1, 1)
 fn reduce_none_$op(@builtin(global_invocation_id) gid: vec3<u32>) {
   if (gid.x < num_outputs) {
-    output[gid.x] = get_initial_value_$op();
+    output[gid.x] = total_to_output(get_initial_value_$op());
   }
 }
 
@@ -1,5 +1,151 @@
 // include constants.wgsl
 
+// The prologue ops are applied to input when loading it, and the results are
+// reduced with the data type of output.
+if ($has_prologue) {
+  alias load_dtype = output_dtype;
+} else {
+  alias load_dtype = $input_dtype;
+}
+
+if ($has_binary_op) {
+  @group(0) @binding($other_binding) var<storage, read> prologue_other: array<$input_dtype>;
+}
+
+fn load_input(input: ptr<storage, array<$input_dtype>>, offset: u32) -> load_dtype {
+  if ($has_binary_op) {
+    let value = $input_dtype($binary_op(input[offset], prologue_other[offset]));
+  } else {
+    let value = input[offset];
+  }
+  if ($has_unary_op) {
+    return load_dtype(betann_$unary_op(value));
+  } else {
+    return load_dtype(value);
+  }
+}
+
+if ($arg_reduce) {
+  // The arg reductions carry the value and its index in the reduction, and the
+  // index is written to output.
+  struct reduce_total {
+    value: $input_dtype,
+    index: u32,
+  };
+
+  // The index of a total that has not seen any input.
+  const arg_empty_index = max_value_u32;
+
+  const initial_value_argmin = reduce_total(max_value_$input_dtype, arg_empty_index);
+  const initial_value_argmax = reduce_total(min_value_$input_dtype, arg_empty_index);
+
+  fn input_to_total(value: $input_dtype, index: u32) -> reduce_total {
+    return reduce_total(value, index);
+  }
+
+  fn total_to_output(total: reduce_total) -> output_dtype {
+    return output_dtype(total.index);
+  }
+
+  // The values of found indices.
+  alias values_dtype = $input_dtype;
+
+  fn total_to_values(total: reduce_total) -> values_dtype {
+    return total.value;
+  }
+
+  if ($enable_subgroups) {
+    fn subgroup_shuffle_xor_total(total: reduce_total, mask: u32) -> reduce_total {
+      return reduce_total(subgroupShuffleXor(total.value, mask),
+                          subgroupShuffleXor(total.index, mask));
+    }
+  }
+}
+
+if ($welford_reduce) {
+  // The mean/variance reduction carries the mean, the sum of squares of
+  // differences from the mean, and the count of elements, which are always
+  // accumulated in f32. The mean is written to output.
+  struct reduce_total {
+    mean: f32,
+    m2: f32,
+    count: u32,
+  };
+
+  const initial_value_meanvar = reduce_total(0, 0, 0);
+
+  fn input_to_total(value: load_dtype, index: u32) -> reduce_total {
+    return reduce_total(f32(value), 0, 1);
+  }
+
+  fn total_to_output(total: reduce_total) -> output_dtype {
+    return output_dtype(total.mean);
+  }
+
+  // The population variance.
+  alias values_dtype = output_dtype;
+
+  fn total_to_values(total: reduce_total) -> values_dtype {
+    if (total.count == 0) {
+      return 0;
+    }
+    return values_dtype(total.m2 / f32(total.count));
+  }
+
+  if ($enable_subgroups) {
+    fn subgroup_shuffle_xor_total(total: reduce_total, mask: u32) -> reduce_total {
+      return reduce_total(subgroupShuffleXor(total.mean, mask),
+                          subgroupShuffleXor(total.m2, mask),
+                          subgroupShuffleXor(total.count, mask));
+    }
+  }
+}
+
+if ($logsumexp_reduce) {
+  // The logsumexp reduction carries the running max and the sum of
+  // exp(x - max), which are always accumulated in f32, so the result is got in
+  // one pass without overflowing exp.
+  struct reduce_total {
+    max: f32,
+    sum: f32,
+  };
+
+  const initial_value_logsumexp = reduce_total(-max_value_f32, 0);
+
+  fn input_to_total(value: load_dtype, index: u32) -> reduce_total {
+    return reduce_total(f32(value), 1);
+  }
+
+  fn total_to_output(total: reduce_total) -> output_dtype {
+    return output_dtype(total.max + log(total.sum));
+  }
+
+  if ($enable_subgroups) {
+    fn subgroup_shuffle_xor_total(total: reduce_total, mask: u32) -> reduce_total {
+      return reduce_total(subgroupShuffleXor(total.max, mask),
+                          subgroupShuffleXor(total.sum, mask));
+    }
+  }
+}
+
+if (!$struct_total) {
+  alias reduce_total = output_dtype;
+
+  fn input_to_total(value: load_dtype, index: u32) -> reduce_total {
+    return output_dtype(value);
+  }
+
+  fn total_to_output(total: reduce_total) -> output_dtype {
+    return total;
+  }
+
+  alias values_dtype = output_dtype;
+
+  fn total_to_values(total: reduce_total) -> values_dtype {
+    return total;
+  }
+}
+
 // The initial values for reduction ops.
 const initial_value_and = output_dtype(1);
 const initial_value_or = output_dtype(0);
@@ -8,7 +154,7 @@ const initial_value_prod = output_dtype(1);
 const initial_value_min = max_value_$output_dtype;
 const initial_value_max = min_value_$output_dtype;
 
-fn get_initial_value_$op() -> output_dtype {
+fn get_initial_value_$op() -> reduce_total {
   return initial_value_$op;
 }
 
@@ -37,6 +183,64 @@ fn reduce_op_max(a: output_dtype, b: output_dtype) -> output_dtype {
   return max(a, b);
 }
 
+if ($arg_reduce) {
+  // Ties are resolved to the smaller index, so the result does not depend on
+  // the order of reduction.
+  fn reduce_op_argmin(a: reduce_total, b: reduce_total) -> reduce_total {
+    let a_first = b.index == arg_empty_index ||
+                  (a.index != arg_empty_index &&
+                   (a.value < b.value || (a.value == b.value && a.index < b.index)));
+    if (a_first) {
+      return a;
+    }
+    return b;
+  }
+
+  fn reduce_op_argmax(a: reduce_total, b: reduce_total) -> reduce_total {
+    let a_first = b.index == arg_empty_index ||
+                  (a.index != arg_empty_index &&
+                   (a.value > b.value || (a.value == b.value && a.index < b.index)));
+    if (a_first) {
+      return a;
+    }
+    return b;
+  }
+}
+
+if ($welford_reduce) {
+  // Merge the partial results with Chan's algorithm, which is also Welford's
+  // algorithm when b has only one element.
+  fn reduce_op_meanvar(a: reduce_total, b: reduce_total) -> reduce_total {
+    let count = a.count + b.count;
+    if (count == 0) {
+      return a;
+    }
+    let delta = b.mean - a.mean;
+    let b_weight = f32(b.count) / f32(count);
+    let mean = a.mean + delta * b_weight;
+    let m2 = a.m2 + b.m2 + delta * delta * f32(a.count) * b_weight;
+    return reduce_total(mean, m2, count);
+  }
+}
+
+if ($logsumexp_reduce) {
+  // Rescale the sum of the smaller max, empty totals are skipped so exp never
+  // sees the initial max. The scale of the larger max is always 1, as
+  // subtracting an infinite max from itself would give NaN.
+  fn reduce_op_logsumexp(a: reduce_total, b: reduce_total) -> reduce_total {
+    if (b.sum == 0) {
+      return a;
+    }
+    if (a.sum == 0) {
+      return b;
+    }
+    let m = max(a.max, b.max);
+    let a_scale = select(exp(a.max - m), 1.0, a.max == m);
+    let b_scale = select(exp(b.max - m), 1.0, b.max == m);
+    return reduce_total(m, a.sum * a_scale + b.sum * b_scale);
+  }
+}
+
 if ($enable_subgroups) {
   fn reduce_subgroup_op_and(v: output_dtype) -> output_dtype {
     return output_dtype(subgroupAll(bool(v)));
@@ -61,14 +265,28 @@ if ($enable_subgroups) {
   fn reduce_subgroup_op_max(v: output_dtype) -> output_dtype {
     return subgroupMax(v);
   }
+
+  if ($struct_total) {
+    // There is no subgroup builtin for structs, so shuffle them and reduce
+    // with the same op used by threads.
+    fn reduce_subgroup_op_$op(v: reduce_total, subgroup_size: u32) -> reduce_total {
+      var total = v;
+      for (var delta = subgroup_size / 2; delta >= 1; delta >>= 1) {
+        total = reduce_op_$op(total, subgroup_shuffle_xor_total(total, delta));
+      }
+      return total;
+    }
+  }
 }
 
 if ($use_reduce_utilities) {
   // Reduce the row.
-  fn row_reduce(total: ptr<function, output_dtype>,
+  // The |index_offset| is the index of row's first element in the reduction.
+  fn row_reduce(total: ptr<function, reduce_total>,
                 lid: u32,
                 input: ptr<storage, array<input_dtype>>,
                 row_offset: u32,
+                index_offset: u32,
                 row_size: u32,
                 workgroup_size: u32,
                 work_per_thread: u32) {
@@ -77,7 +295,8 @@ if ($use_reduce_utilities) {
     for (var block = 0u; block < row_size / block_size; block++) {
       let idx = block * block_size + lid * work_per_thread;
       for (var i = 0u; i < work_per_thread; i++) {
-        *total = reduce_op_$op(output_dtype(input[row_offset + idx + i]), *total);
+        let value = input_to_total(load_input(input, row_offset + idx + i), index_offset + idx + i);
+        *total = reduce_op_$op(value, *total);
       }
     }
 
@@ -86,20 +305,40 @@ if ($use_reduce_utilities) {
     if (leftover != 0) {
       let idx = (row_size - leftover) + lid * work_per_thread;
       for (var i = 0u; i < work_per_thread && idx + i < row_size; i++) {
-        *total = reduce_op_$op(output_dtype(input[row_offset + idx + i]), *total);
+        let value = input_to_total(load_input(input, row_offset + idx + i), index_offset + idx + i);
+        *total = reduce_op_$op(value, *total);
       }
     }
   }
 
+  // Reduce the row whose elements are |row_stride| apart.
+  fn row_reduce_strided(total: ptr<function, reduce_total>,
+                        lid: u32,
+                        input: ptr<storage, array<input_dtype>>,
+                        row_offset: u32,
+                        index_offset: u32,
+                        row_size: u32,
+                        row_stride: u32,
+                        workgroup_size: u32) {
+    for (var i = lid; i < row_size; i += workgroup_size) {
+      let value = input_to_total(load_input(input, row_offset + i * row_stride), index_offset + i);
+      *total = reduce_op_$op(value, *total);
+    }
+  }
+
   // Reduce results from workgroup threads to total.
-  fn workgroup_reduce(total: ptr<function, output_dtype>,
+  fn workgroup_reduce(total: ptr<function, reduce_total>,
                       lid: u32,
                       workgroup_size: u32,
                       subgroup_gid: u32,
                       subgroup_size: u32) {
     if ($enable_subgroups) {
       // Subgroup reduction.
-      *total = reduce_subgroup_op_$op(*total);
+      if ($struct_total) {
+        *total = reduce_subgroup_op_$op(*total, subgroup_size);
+      } else {
+        *total = reduce_subgroup_op_$op(*total);
+      }
 
       // Workgroup reduction.
       // FIXME(zcbenz): Must convert delta to f32 for comparison, possible Metal bug.
@@ -111,8 +350,16 @@ if ($use_reduce_utilities) {
 
         // Subgroup reduction.
         workgroupBarrier();
-        *total = select(initial_value_$op, workgroup_totals[lid], lid < delta);
-        *total = reduce_subgroup_op_$op(*total);
+        if (lid < delta) {
+          *total = workgroup_totals[lid];
+        } else {
+          *total = initial_value_$op;
+        }
+        if ($struct_total) {
+          *total = reduce_subgroup_op_$op(*total, subgroup_size);
+        } else {
+          *total = reduce_subgroup_op_$op(*total);
+        }
       }
     } else {
       // Write to shared memory.
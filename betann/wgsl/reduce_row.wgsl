@@ -27,6 +27,12 @@ if ($use_fast_index) {
 @group(0) @binding(6) var<storage, read> non_reduction_strides: array<u32>;
 @group(0) @binding(7) var<storage, read> reduction_shape: array<u32>;
 @group(0) @binding(8) var<storage, read> reduction_strides: array<u32>;
+if (!$row_contiguous) {
+  @group(0) @binding(9) var<uniform> row_stride: u32;
+}
+if ($write_values) {
+  @group(0) @binding($values_binding) var<storage, read_write> output_values: array<values_dtype>;
+}
 
 @compute @workgroup_size(workgroup_size, 1, 1)
 fn reduce_row_1d_$op(@builtin(global_invocation_id) gid: vec3<u32>) {
@@ -52,16 +58,23 @@ fn reduce_row_1d_$op(@builtin(global_invocation_id) gid: vec3<u32>) {
     } else {
       let row_offset = input_offset + coord_to_index(r, &reduction_shape, &reduction_strides);
     }
-    row_reduce(&total, 0, &input, row_offset, row_size, 1, work_per_thread);
+    if ($row_contiguous) {
+      row_reduce(&total, 0, &input, row_offset, r * row_size, row_size, 1, work_per_thread);
+    } else {
+      row_reduce_strided(&total, 0, &input, row_offset, r * row_size, row_size, row_stride, 1);
+    }
   }
 
-  output[gid.x] = total;
+  output[gid.x] = total_to_output(total);
+  if ($write_values) {
+    output_values[gid.x] = total_to_values(total);
+  }
 }
 
 if ($enable_subgroups) {
-  var<workgroup> workgroup_totals: array<output_dtype, workgroup_size / $subgroup_min_size>;
+  var<workgroup> workgroup_totals: array<reduce_total, workgroup_size / $subgroup_min_size>;
 } else {
-  var<workgroup> workgroup_totals: array<output_dtype, workgroup_size>;
+  var<workgroup> workgroup_totals: array<reduce_total, workgroup_size>;
 }
 
 @compute @workgroup_size(workgroup_size, 1, 1)
@@ -70,10 +83,19 @@ fn reduce_row_2d_$op(if ($enable_subgroups) {
                        @builtin(subgroup_invocation_id) subgroup_gid: u32,
                      }
                      @builtin(global_invocation_id) gid: vec3<u32>,
-                     @builtin(local_invocation_id) lid: vec3<u32>) {
+                     @builtin(local_invocation_id) lid: vec3<u32>,
+                     @builtin(workgroup_id) tid: vec3<u32>,
+                     @builtin(num_workgroups) num_workgroups: vec3<u32>) {
   // The index in non-reduction dimensions.
   var input_offset = coord_to_index(gid.y, &non_reduction_shape, &non_reduction_strides);
 
+  // When long rows are split among workgroups, each works on a range of the
+  // rows, and the partial results are written as [num_outputs, split_count].
+  let split_count = num_workgroups.x;
+  let split_size = (row_size + split_count - 1) / split_count;
+  let split_begin = min(tid.x * split_size, row_size);
+  let split_end = min(split_begin + split_size, row_size);
+
   if ($use_fast_index) {
     // Stateful computation of index in reduction dimensions.
     var index_state: coord_to_index_state;
@@ -89,7 +111,19 @@ fn reduce_row_2d_$op(if ($enable_subgroups) {
     } else {
       let row_offset = input_offset + coord_to_index(r, &reduction_shape, &reduction_strides);
     }
-    row_reduce(&total, lid.x, &input, row_offset, row_size, workgroup_size, work_per_thread);
+    if ($row_contiguous) {
+      row_reduce(&total, lid.x, &input,
+                 row_offset + split_begin,
+                 r * row_size + split_begin,
+                 split_end - split_begin,
+                 workgroup_size, work_per_thread);
+    } else {
+      row_reduce_strided(&total, lid.x, &input,
+                         row_offset + split_begin * row_stride,
+                         r * row_size + split_begin,
+                         split_end - split_begin,
+                         row_stride, workgroup_size);
+    }
   }
 
   // Reduce across the workgroup.
@@ -101,7 +135,11 @@ fn reduce_row_2d_$op(if ($enable_subgroups) {
 
   // Write output.
   if (lid.x == 0 && gid.y < num_outputs) {
-    output[gid.y] = total;
+    let out_idx = gid.y * split_count + tid.x;
+    output[out_idx] = total_to_output(total);
+    if ($write_values) {
+      output_values[out_idx] = total_to_values(total);
+    }
   }
 }
 
@@ -0,0 +1,158 @@
+if ($enable_f16) {
+  enable f16;
+}
+
+alias dtype = $dtype;
+
+// The sorted values (and indices) are stored in temporary buffers laid out as
+// [rows, size_sorted_axis], until the last pass writes to output.
+if ($write_output) {
+  if ($argsort) {
+    @group(0) @binding(0) var<storage, read_write> out: array<u32>;
+  } else {
+    @group(0) @binding(0) var<storage, read_write> out: array<dtype>;
+  }
+} else {
+  @group(0) @binding(0) var<storage, read_write> vals_out: array<dtype>;
+}
+@group(0) @binding(1) var<uniform> size_sorted_axis: u32;
+@group(0) @binding(2) var<storage, read> vals_in: array<dtype>;
+@group(0) @binding(3) var<uniform> merge_tiles: u32;
+if ($write_output) {
+  @group(0) @binding(4) var<uniform> out_stride_sorted_axis: u32;
+  @group(0) @binding(5) var<storage, read> out_rest_shape: array<u32>;
+  @group(0) @binding(6) var<storage, read> out_rest_strides: array<u32>;
+  if ($argsort) {
+    @group(0) @binding(7) var<storage, read> idxs_in: array<u32>;
+  }
+} else {
+  if ($argsort) {
+    @group(0) @binding(4) var<storage, read> idxs_in: array<u32>;
+    @group(0) @binding(5) var<storage, read_write> idxs_out: array<u32>;
+  }
+}
+
+var<workgroup> workgroup_partitions: array<u32, 2>;
+
+// Every merge_tiles blocks form a merge group, which merges 2 sorted ranges of
+// (merge_tiles / 2) blocks, and each workgroup produces one block of the merged
+// result by finding where the merge path enters and leaves its block.
+@compute @workgroup_size(num_threads, 1, 1)
+fn sort_merge(@builtin(workgroup_id) tid: vec3<u32>,
+              @builtin(local_invocation_id) lid: vec3<u32>) {
+  let row_offset = tid.y * size_sorted_axis;
+
+  let merge_group = tid.x / merge_tiles;
+  let merge_lane = tid.x % merge_tiles;
+
+  let sort_size = n_per_block * merge_tiles;
+  let sort_start = sort_size * merge_group;
+
+  // Elements are sorted:
+  // vals_in[a_start, a_end) and vals_in[b_start, b_end)
+  let a_start = min(size_sorted_axis, sort_start);
+  let a_end = min(size_sorted_axis, sort_start + sort_size / 2);
+  let b_start = a_end;
+  let b_end = min(size_sorted_axis, b_start + sort_size / 2);
+
+  // Find the partitions at the start and end of current block.
+  let median_start = min(b_end - a_start, n_per_block * merge_lane);
+  let median_end = min(b_end - a_start, n_per_block * (merge_lane + 1));
+  if (lid.x < 2) {
+    workgroup_partitions[lid.x] =
+        merge_partition_global(row_offset + a_start, a_end - a_start,
+                               row_offset + b_start, b_end - b_start,
+                               select(median_start, median_end, lid.x == 1));
+  }
+  workgroupBarrier();
+
+  let a_part_start = a_start + workgroup_partitions[0];
+  let a_size = workgroup_partitions[1] - workgroup_partitions[0];
+  let b_part_start = b_start + median_start - workgroup_partitions[0];
+  let b_size = median_end - median_start - a_size;
+
+  // Copy both parts into workgroup memory.
+  for (var i = lid.x; i < n_per_block; i += num_threads) {
+    var pos = row_offset;
+    if (i < a_size) {
+      pos += a_part_start + i;
+    } else {
+      pos += b_part_start + i - a_size;
+    }
+    workgroup_vals[i] = select(get_max_value_$dtype(),
+                               vals_in[pos],
+                               i < a_size + b_size);
+    if ($argsort) {
+      workgroup_idxs[i] = select(size_sorted_axis,
+                                 idxs_in[pos],
+                                 i < a_size + b_size);
+    }
+  }
+  workgroupBarrier();
+
+  // Merge in workgroup and store results in thread registers.
+  var vals: array<dtype, work_per_thread>;
+  var idxs: array<u32, work_per_thread>;
+  let sort_median = min(a_size + b_size, work_per_thread * lid.x);
+  let part = merge_partition(0, a_size, a_size, b_size, sort_median);
+  merge_step(part, a_size - part,
+             a_size + sort_median - part, b_size - sort_median + part,
+             &vals, &idxs);
+
+  // Write out to shared memory.
+  workgroupBarrier();
+  for (var i: u32 = 0; i < work_per_thread; i++) {
+    workgroup_vals[lid.x * work_per_thread + i] = vals[i];
+    if ($argsort) {
+      workgroup_idxs[lid.x * work_per_thread + i] = idxs[i];
+    }
+  }
+  workgroupBarrier();
+
+  // Write output.
+  if ($write_output) {
+    let out_offset = coord_to_index(tid.y, &out_rest_shape, &out_rest_strides);
+  }
+  for (var i = lid.x; i < a_size + b_size; i += num_threads) {
+    let pos = a_start + median_start + i;
+    if ($write_output) {
+      let out_idx = out_offset + pos * out_stride_sorted_axis;
+      if ($argsort) {
+        out[out_idx] = workgroup_idxs[i];
+      } else {
+        out[out_idx] = workgroup_vals[i];
+      }
+    } else {
+      vals_out[row_offset + pos] = workgroup_vals[i];
+      if ($argsort) {
+        idxs_out[row_offset + pos] = workgroup_idxs[i];
+      }
+    }
+  }
+}
+
+// Same with merge_partition but reads the sorted ranges from vals_in.
+fn merge_partition_global(a_offset: u32, a_size: u32,
+                          b_offset: u32, b_size: u32,
+                          sort_median: u32) -> u32 {
+  var a_start = select(0, sort_median - b_size, sort_median > b_size);
+  var a_end = min(sort_median, a_size);
+
+  while (a_start < a_end) {
+    let middle = a_start + (a_end - a_start) / 2;
+    let a = vals_in[a_offset + middle];
+    let b = vals_in[b_offset + sort_median - 1 - middle];
+
+    if (compare_op(b, a)) {
+      a_end = middle;
+    } else {
+      a_start = middle + 1;
+    }
+  }
+
+  return a_end;
+}
+
+// include sort_ops.wgsl
+// include utils.wgsl
+// include constants.wgsl
@@ -0,0 +1,226 @@
+if ($enable_f16) {
+  enable f16;
+}
+
+alias dtype = $dtype;
+
+@group(0) @binding(0) var<storage, read> input: array<dtype>;
+@group(0) @binding(1) var<uniform> size_sorted_axis: u32;
+@group(0) @binding(2) var<uniform> input_stride_sorted_axis: u32;
+@group(0) @binding(3) var<uniform> k: u32;
+@group(0) @binding(4) var<storage, read> rest_shape: array<u32>;
+@group(0) @binding(5) var<storage, read> input_rest_strides: array<u32>;
+@group(0) @binding(6) var<uniform> out_stride_sorted_axis: u32;
+@group(0) @binding(7) var<storage, read> out_rest_strides: array<u32>;
+if ($has_values) {
+  @group(0) @binding($values_binding) var<storage, read_write> out_values: array<dtype>;
+}
+if ($has_indices) {
+  @group(0) @binding($indices_binding) var<storage, read_write> out_indices: array<u32>;
+}
+
+const invalid_index: u32 = 0xffffffffu;
+
+// Each thread of topk_insert keeps a list of max_k candidates, and the lists
+// of all threads fit in workgroup memory for merging.
+const max_k: u32 = $max_k;
+const insert_threads: u32 = 1024 / max_k;
+
+var<workgroup> workgroup_vals: array<dtype, insert_threads * max_k>;
+var<workgroup> workgroup_idxs: array<u32, insert_threads * max_k>;
+
+// Find top k of each row for small k, each thread inserts its elements into a
+// sorted list in registers, and then the lists are merged in pairs. The merged
+// list is written in the order of indices, same with topk_select.
+@compute @workgroup_size(insert_threads, 1, 1)
+fn topk_insert(@builtin(workgroup_id) tid: vec3<u32>,
+               @builtin(local_invocation_id) lid: vec3<u32>) {
+  let input_offset = coord_to_index(tid.y, &rest_shape, &input_rest_strides);
+
+  // The list of candidates sorted in descending order.
+  var vals: array<dtype, max_k>;
+  var idxs: array<u32, max_k>;
+  for (var j: u32 = 0; j < max_k; j++) {
+    idxs[j] = invalid_index;
+  }
+  for (var i = lid.x; i < size_sorted_axis; i += insert_threads) {
+    let value = input[input_offset + i * input_stride_sorted_axis];
+    if (!is_before(value, i, vals[k - 1], idxs[k - 1])) {
+      continue;
+    }
+    var j = k - 1;
+    while (j > 0 && is_before(value, i, vals[j - 1], idxs[j - 1])) {
+      vals[j] = vals[j - 1];
+      idxs[j] = idxs[j - 1];
+      j--;
+    }
+    vals[j] = value;
+    idxs[j] = i;
+  }
+
+  // Merge lists of threads.
+  let offset = lid.x * max_k;
+  for (var j: u32 = 0; j < k; j++) {
+    workgroup_vals[offset + j] = vals[j];
+    workgroup_idxs[offset + j] = idxs[j];
+  }
+  for (var delta = insert_threads / 2; delta >= 1; delta >>= 1) {
+    workgroupBarrier();
+    if (lid.x < delta) {
+      var a_vals = vals;
+      var a_idxs = idxs;
+      let b_offset = (lid.x + delta) * max_k;
+      var a: u32 = 0;
+      var b: u32 = 0;
+      for (var j: u32 = 0; j < k; j++) {
+        let b_val = workgroup_vals[b_offset + b];
+        let b_idx = workgroup_idxs[b_offset + b];
+        if (is_before(b_val, b_idx, a_vals[a], a_idxs[a])) {
+          vals[j] = b_val;
+          idxs[j] = b_idx;
+          b++;
+        } else {
+          vals[j] = a_vals[a];
+          idxs[j] = a_idxs[a];
+          a++;
+        }
+        workgroup_vals[offset + j] = vals[j];
+        workgroup_idxs[offset + j] = idxs[j];
+      }
+    }
+  }
+  workgroupBarrier();
+
+  // Write output in the order of indices, where the position of each element
+  // is the number of elements with smaller indices.
+  let out_offset = coord_to_index(tid.y, &rest_shape, &out_rest_strides);
+  for (var j = lid.x; j < k; j += insert_threads) {
+    var rank: u32 = 0;
+    for (var m: u32 = 0; m < k; m++) {
+      rank += u32(workgroup_idxs[m] < workgroup_idxs[j]);
+    }
+    let out_idx = out_offset + rank * out_stride_sorted_axis;
+    if ($has_values) {
+      out_values[out_idx] = workgroup_vals[j];
+    }
+    if ($has_indices) {
+      out_indices[out_idx] = workgroup_idxs[j];
+    }
+  }
+}
+
+// Whether element a goes before element b in the top k, ties are broken by
+// index so results are deterministic. Values are compared by their radix keys
+// like topk_select, so a NaN ranks above +inf or below -inf by its sign bit,
+// and -0 ranks below +0.
+fn is_before(a_val: dtype, a_idx: u32, b_val: dtype, b_idx: u32) -> bool {
+  if (a_idx == invalid_index) {
+    return false;
+  }
+  if (b_idx == invalid_index) {
+    return true;
+  }
+  let a_bits = key_to_bits(a_val);
+  let b_bits = key_to_bits(b_val);
+  return a_bits > b_bits || (a_bits == b_bits && a_idx < b_idx);
+}
+
+const select_threads: u32 = 256;
+const select_bits: u32 = 8;
+
+var<workgroup> workgroup_counts: array<atomic<u32>, 1 << select_bits>;
+var<workgroup> workgroup_selected: vec2<u32>;
+var<workgroup> workgroup_scan: array<vec2<u32>, select_threads>;
+
+// Find top k of each row for large k, the bits of k-th largest element are
+// found digit by digit from the highest, by counting the digits of elements
+// that match the found bits. Elements larger than the k-th largest are then
+// all written, and the equal ones with the lowest indices written until there
+// are k elements.
+@compute @workgroup_size(select_threads, 1, 1)
+fn topk_select(@builtin(workgroup_id) tid: vec3<u32>,
+               @builtin(local_invocation_id) lid: vec3<u32>) {
+  let input_offset = coord_to_index(tid.y, &rest_shape, &input_rest_strides);
+
+  var prefix: u32 = 0;
+  var prefix_mask: u32 = 0;
+  // Number of elements still needed among the ones matching the prefix.
+  var remaining = k;
+  for (var shift = key_bits; shift > 0;) {
+    shift -= select_bits;
+    atomicStore(&workgroup_counts[lid.x], 0);
+    workgroupBarrier();
+    for (var i = lid.x; i < size_sorted_axis; i += select_threads) {
+      let bits = key_to_bits(input[input_offset + i * input_stride_sorted_axis]);
+      if ((bits & prefix_mask) == prefix) {
+        atomicAdd(&workgroup_counts[(bits >> shift) & 0xff], 1);
+      }
+    }
+    workgroupBarrier();
+    if (lid.x == 0) {
+      var total: u32 = 0;
+      for (var d: i32 = 0xff; d >= 0; d--) {
+        let count = atomicLoad(&workgroup_counts[d]);
+        if (total + count >= remaining) {
+          workgroup_selected = vec2<u32>(u32(d), remaining - total);
+          break;
+        }
+        total += count;
+      }
+    }
+    let selected = workgroupUniformLoad(&workgroup_selected);
+    prefix |= selected.x << shift;
+    prefix_mask |= 0xffu << shift;
+    remaining = selected.y;
+  }
+
+  // Write output in the order of indices. The row is read in chunks, and the
+  // output positions of the larger and equal elements in each chunk are found
+  // by prefix sums, so the result does not depend on the order of threads.
+  let out_offset = coord_to_index(tid.y, &rest_shape, &out_rest_strides);
+  var written = vec2<u32>(0, 0);
+  for (var start: u32 = 0; start < size_sorted_axis; start += select_threads) {
+    let i = start + lid.x;
+    var value: dtype;
+    var flags = vec2<u32>(0, 0);
+    if (i < size_sorted_axis) {
+      value = input[input_offset + i * input_stride_sorted_axis];
+      let bits = key_to_bits(value);
+      flags = vec2<u32>(u32(bits > prefix), u32(bits == prefix));
+    }
+    // Inclusive scan of the flags in workgroup.
+    workgroup_scan[lid.x] = flags;
+    for (var delta: u32 = 1; delta < select_threads; delta <<= 1) {
+      workgroupBarrier();
+      var sum = workgroup_scan[lid.x];
+      if (lid.x >= delta) {
+        sum += workgroup_scan[lid.x - delta];
+      }
+      workgroupBarrier();
+      workgroup_scan[lid.x] = sum;
+    }
+    let before = written + workgroup_scan[lid.x] - flags;
+    var j = k;
+    if (flags.x == 1) {
+      j = before.x;
+    } else if (flags.y == 1 && before.y < remaining) {
+      j = k - remaining + before.y;
+    }
+    if (j < k) {
+      let out_idx = out_offset + j * out_stride_sorted_axis;
+      if ($has_values) {
+        out_values[out_idx] = value;
+      }
+      if ($has_indices) {
+        out_indices[out_idx] = i;
+      }
+    }
+    written += workgroupUniformLoad(&workgroup_scan[select_threads - 1]);
+    if (written.x + min(written.y, remaining) == k) {
+      break;
+    }
+  }
+}
+
+// include radix_keys.wgsl
+// include utils.wgsl
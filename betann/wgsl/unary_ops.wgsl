@@ -103,6 +103,10 @@ fn betann_erf(input: input_dtype) -> return_dtype {
   } else {
     let v = f32(input);
   }
+  return betann_erf_approx(v);
+}
+
+fn betann_erf_approx(v: return_dtype) -> return_dtype {
   let absv = abs(v);
   let x = 1 / (1 + r0 * absv);
   return sign(v) * (1 - ((((r5 * x + r4) * x + r3) * x + r2) * x + r1) * x * exp(-absv * absv));
@@ -141,6 +145,11 @@ fn betann_floor(input: input_dtype) -> input_dtype {
   }
 }
 
+fn betann_gelu(input: input_dtype) -> return_dtype {
+  let v = return_dtype(input);
+  return v * 0.5 * (1 + betann_erf_approx(v * 0.7071067811865476));
+}
+
 fn betann_log(input: input_dtype) -> return_dtype {
   if ($input_is_floating) {
     return log(input);
@@ -210,6 +219,10 @@ fn betann_sign(input: input_dtype) -> input_dtype {
   }
 }
 
+fn betann_silu(input: input_dtype) -> return_dtype {
+  return return_dtype(input) * betann_sigmoid(input);
+}
+
 fn betann_sin(input: input_dtype) -> return_dtype {
   if ($input_is_floating) {
     return sin(input);
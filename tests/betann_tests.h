@@ -17,6 +17,14 @@ class BetaNNTests : public testing::Test {
     return out;
   }
 
+  template<typename T>
+  betann::Buffer CreateOutput(size_t size) {
+    return device_.CreateBuffer(
+        size * sizeof(T),
+        betann::BufferUsage::Storage | betann::BufferUsage::CopySrc |
+        betann::BufferUsage::CopyDst);
+  }
+
   template<typename T>
   std::vector<T> RandomNumbers(size_t size, int upper = 8964, int lower = 2) {
     std::uniform_int_distribution<int32_t> dist(lower, upper);
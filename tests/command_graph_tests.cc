@@ -0,0 +1,91 @@
+#include "betann_tests.h"
+
+#include <numeric>
+
+#include "betann/reduce.h"
+
+class CommandGraphTests : public BetaNNTests {};
+
+TEST_F(CommandGraphTests, Replay) {
+  auto a = RandomNumbers<float>(100);
+  auto b = RandomNumbers<float>(100);
+  betann::Buffer aBuffer = device_.CreateBufferFromVector(a);
+  betann::Buffer bBuffer = device_.CreateBufferFromVector(b);
+  betann::Buffer out = CreateOutput<float>(100);
+  device_.BeginCapture();
+  betann::BinaryOpContiguous(device_,
+                             "add",
+                             betann::BinaryOpType::VectorVector,
+                             betann::DataType::F32,
+                             out,
+                             100,
+                             betann::DataType::F32,
+                             aBuffer,
+                             bBuffer);
+  betann::CommandGraph graph = device_.EndCapture();
+  EXPECT_EQ(graph.GetCommandCount(), 1);
+  // Nothing is run when capturing.
+  device_.Flush();
+  EXPECT_EQ(ReadFromBuffer<float>(out, 100), std::vector<float>(100, 0));
+  // Replay twice.
+  for (int r = 0; r < 2; ++r) {
+    device_.Replay(graph);
+    device_.Flush();
+    std::vector<float> expected;
+    for (size_t i = 0; i < a.size(); ++i)
+      expected.push_back(a[i] + b[i]);
+    EXPECT_EQ(ReadFromBuffer<float>(out, 100), expected);
+  }
+}
+
+TEST_F(CommandGraphTests, Rebind) {
+  uint32_t M = 17, K = 129;
+  auto x = RandomNumbers<float>(M * K, 10);
+  auto y = RandomNumbers<float>(K, 10);
+  betann::Buffer xBuffer = device_.CreateBufferFromVector(x);
+  betann::Buffer out = CreateOutput<float>(M);
+  device_.BeginCapture();
+  betann::MatrixMultiply(device_, betann::DataType::F32,
+                         out,
+                         xBuffer, {M, K}, {K, 1},
+                         device_.CreateBufferFromVector(y), {K, 1}, {1, 1});
+  betann::Buffer copied = CreateOutput<float>(M);
+  device_.CopyBufferToBuffer(out, 0, copied, 0, M * sizeof(float));
+  betann::CommandGraph graph = device_.EndCapture();
+  EXPECT_EQ(graph.GetCommandCount(), 2);
+  graph.DeclareBindings({xBuffer, out, copied});
+  for (int r = 0; r < 3; ++r) {
+    x = RandomNumbers<float>(M * K, 10);
+    betann::Buffer newOut = CreateOutput<float>(M);
+    betann::Buffer newCopied = CreateOutput<float>(M);
+    device_.Replay(graph,
+                   {device_.CreateBufferFromVector(x), newOut, newCopied});
+    device_.Flush();
+    auto expected = CpuMatmul(x, {M, K}, {K, 1}, y, {K, 1}, {1, 1});
+    EXPECT_EQ(ReadFromBuffer<float>(newOut, M), expected);
+    EXPECT_EQ(ReadFromBuffer<float>(newCopied, M), expected);
+  }
+}
+
+TEST_F(CommandGraphTests, ReplayTwoPassReduce) {
+  // Large enough for reducing in 2 passes, whose partial results must be kept
+  // by the graph for replays.
+  auto a = RandomNumbers<int32_t>(100000, 10);
+  betann::Buffer out = CreateOutput<int32_t>(1);
+  device_.BeginCapture();
+  betann::ReduceAll(device_,
+                    betann::ReduceType::Sum,
+                    betann::DataType::I32,
+                    out,
+                    betann::DataType::I32,
+                    device_.CreateBufferFromVector(a),
+                    a.size());
+  betann::CommandGraph graph = device_.EndCapture();
+  EXPECT_EQ(graph.GetCommandCount(), 2);
+  for (int r = 0; r < 3; ++r) {
+    device_.Replay(graph);
+    device_.Flush();
+    EXPECT_EQ(ReadFromBuffer<int32_t>(out, 1)[0],
+              std::accumulate(a.begin(), a.end(), 0));
+  }
+}
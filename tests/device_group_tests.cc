@@ -0,0 +1,91 @@
+#include "betann_tests.h"
+
+#include <fmt/format.h>
+
+#include "betann/device_group.h"
+
+class DeviceGroupTests : public BetaNNTests {
+ public:
+  DeviceGroupTests() : group_(TwoDevices()) {}
+
+  // The tests exercise the sharding of work on one physical adapter, whose two
+  // devices are created from adapters of separate enumerations, as each
+  // adapter can only create one device.
+  static std::vector<wgpu::Adapter> TwoDevices() {
+    return {betann::EnumerateAdapters().front(),
+            betann::EnumerateAdapters().front()};
+  }
+
+  betann::DeviceGroup group_;
+};
+
+TEST_F(DeviceGroupTests, ShardBatches) {
+  using Shards = std::vector<std::pair<uint32_t, uint32_t>>;
+  EXPECT_EQ(group_.ShardBatches(0), (Shards{{0, 0}, {0, 0}}));
+  EXPECT_EQ(group_.ShardBatches(1), (Shards{{0, 1}, {1, 1}}));
+  EXPECT_EQ(group_.ShardBatches(5), (Shards{{0, 3}, {3, 5}}));
+}
+
+TEST_F(DeviceGroupTests, MatrixVectorMultiply) {
+  const uint32_t shapes[][3] = {
+    {1, 5, 33},
+    {2, 16, 128},
+    {7, 17, 129},
+  };
+  for (auto [B, M, K] : shapes) {
+    SCOPED_TRACE(fmt::format("Batch: {}, Shape: {}x{}", B, M, K));
+    auto x = RandomNumbers<float>(B * M * K, 10);
+    auto y = RandomNumbers<float>(B * K, 10);
+    std::vector<float> out(B * M);
+    betann::MatrixVectorMultiply(group_, betann::DataType::F32, B, out.data(),
+                                 x.data(), false, M, K, y.data());
+    EXPECT_EQ(out, CpuMatmul(x, {B, M, K}, {M * K, K, 1},
+                             y, {B, K, 1}, {K, 1, 0}));
+    std::vector<float> outT(B * K);
+    y = RandomNumbers<float>(B * M, 10);
+    betann::MatrixVectorMultiply(group_, betann::DataType::F32, B, outT.data(),
+                                 x.data(), true, M, K, y.data());
+    EXPECT_EQ(outT, CpuMatmul(x, {B, K, M}, {M * K, 1, K},
+                              y, {B, M, 1}, {M, 1, 0}));
+  }
+}
+
+TEST_F(DeviceGroupTests, ReduceLast) {
+  const uint32_t shapes[][2] = {
+    {1, 1},
+    {5, 5},
+    {33, 600},
+  };
+  for (auto [M, K] : shapes) {
+    SCOPED_TRACE(fmt::format("Shape: {}x{}", M, K));
+    auto ints = RandomNumbers<int32_t>(M * K, 10);
+    std::vector<int32_t> out(M);
+    betann::ReduceLast(group_, betann::ReduceType::Sum,
+                       betann::DataType::I32, out.data(), M,
+                       betann::DataType::I32, ints.data(), K);
+    std::vector<int32_t> expected;
+    for (uint32_t i = 0; i < M; ++i) {
+      expected.push_back(std::accumulate(ints.begin() + i * K,
+                                         ints.begin() + (i + 1) * K, 0));
+    }
+    EXPECT_EQ(out, expected);
+  }
+}
+
+TEST_F(DeviceGroupTests, SortBlock) {
+  auto a = RandomNumbers<uint32_t>(100);
+  auto b = RandomNumbers<uint32_t>(100);
+  auto c = RandomNumbers<uint32_t>(100);
+  std::vector<uint32_t> out(300);
+  betann::SortBlock(group_, betann::SortResultType::Values, out.data(),
+                    betann::DataType::U32, Concat(a, b, c).data(), 3, 100);
+  std::sort(a.begin(), a.end());
+  std::sort(b.begin(), b.end());
+  std::sort(c.begin(), c.end());
+  EXPECT_EQ(out, Concat(a, b, c));
+  std::vector<float> d = {8, 9, 6, 4, 4, 3, 2, 1, 1, 2, 3, 4};
+  betann::SortBlock(group_, betann::SortResultType::Indices, out.data(),
+                    betann::DataType::F32, d.data(), 3, 4);
+  EXPECT_EQ(std::vector<uint32_t>(out.begin(), out.begin() + 12),
+            (std::vector<uint32_t>{3, 2, 0, 1, 3, 2, 1, 0, 0, 1, 2, 3}));
+}
@@ -293,3 +293,32 @@ TEST_F(MatrixVectorMultiplyTests, TransposeVirtualBatches) {
                         y, {8, B, M, 1}, {0, M, 1, 1}));
   }
 }
+
+TEST_F(MatrixVectorMultiplyTests, SplitK) {
+  for (bool disableSubgroups : GetParameters()) {
+    const uint32_t shapes[][3] = {
+      {1, 4, 4096},
+      {1, 33, 10000},
+      {2, 5, 20000},
+    };
+    for (auto [B, M, K] : shapes) {
+      auto x = RandomNumbers<int32_t>(B * M * K, 10);
+      auto y = RandomNumbers<int32_t>(B * K, 10);
+      SCOPED_TRACE(fmt::format("Subgroups: {}, Batch: {}, Shape: {}x{}",
+                               !disableSubgroups, B, M, K));
+      EXPECT_EQ(GpuGemv(x, {B, M ,K}, {M * K, K, 1},
+                        y, {K, 1, 1},
+                        disableSubgroups),
+                CpuMatmul(x, {B, M, K}, {M * K, K, 1},
+                          y, {B, K, 1}, {K, 1, 0}));
+    }
+  }
+  for (bool disableSubgroups : GetTransposeParameters()) {
+    uint32_t M = 10000, K = 7;
+    auto x = RandomNumbers<int32_t>(M * K, 10);
+    auto y = RandomNumbers<int32_t>(M, 10);
+    SCOPED_TRACE(fmt::format("Transposed, Subgroups: {}", !disableSubgroups));
+    EXPECT_EQ(GpuGemvt(x, {K, M}, {1, K}, y, {1, 0}, disableSubgroups),
+              CpuMatmul(x, {K, M}, {1, K}, y, {M, 1}, {1, 0}));
+  }
+}
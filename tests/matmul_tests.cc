@@ -1,5 +1,11 @@
 #include "betann_tests.h"
 
+#include <cmath>
+
+#include <fmt/format.h>
+
+#include "betann/matmul.h"
+
 class MatrixMultiplyTest : public BetaNNTests {
  public:
   template<typename T>
@@ -8,11 +14,13 @@ class MatrixMultiplyTest : public BetaNNTests {
                            const std::vector<uint32_t>& aStrides,
                            const std::vector<T>& b,
                            const std::vector<uint32_t>& bShape,
-                           const std::vector<uint32_t>& bStrides) {
+                           const std::vector<uint32_t>& bStrides,
+                           const betann::MatmulEpilogue& epilogue = {}) {
+    // Batch dims are broadcasted.
     uint32_t outSize = aShape[aShape.size() - 2] * bShape[bShape.size() - 1];
-    if (aShape.size() > 2) {
-      for (size_t i = 0; i < aShape.size() - 2; ++i)
-        outSize *= aShape[i];
+    for (size_t i = 3; i <= std::max(aShape.size(), bShape.size()); ++i) {
+      outSize *= std::max(i <= aShape.size() ? aShape[aShape.size() - i] : 1,
+                          i <= bShape.size() ? bShape[bShape.size() - i] : 1);
     }
     betann::Buffer out = device_.CreateBuffer(
         outSize * sizeof(T),
@@ -26,7 +34,8 @@ class MatrixMultiplyTest : public BetaNNTests {
        aStrides,
        device_.CreateBufferFromVector(b),
        bShape,
-       bStrides);
+       bStrides,
+       epilogue);
     device_.Flush();
     return ReadFromBuffer<T>(out, outSize);
   }
@@ -162,3 +171,196 @@ TEST_F(MatrixMultiplyTest, GEMVNonContiguousBatch) {
             CpuMatmul(b, {2, 5, 1, 4}, {0, 4, 1, 1},
                       a, {2, 5, 4, 5}, {0, 20, 1, 4}));
 }
+
+TEST_F(MatrixMultiplyTest, GEMMContiguous) {
+  const uint32_t shapes[][3] = {
+    {2, 3, 2},
+    {37, 70, 45},
+    {130, 33, 70},
+  };
+  for (auto [M, K, N] : shapes) {
+    SCOPED_TRACE(fmt::format("Shape: {}x{}x{}", M, K, N));
+    auto a = RandomNumbers<float>(M * K, 10);
+    auto b = RandomNumbers<float>(K * N, 10);
+    // matmul(a, b)
+    EXPECT_EQ(GpuMatmul(a, {M, K}, {K, 1},
+                        b, {K, N}, {N, 1}),
+              CpuMatmul(a, {M, K}, {K, 1},
+                        b, {K, N}, {N, 1}));
+    // matmul(a.T, b)
+    EXPECT_EQ(GpuMatmul(a, {M, K}, {1, M},
+                        b, {K, N}, {N, 1}),
+              CpuMatmul(a, {M, K}, {1, M},
+                        b, {K, N}, {N, 1}));
+    // matmul(a, b.T)
+    EXPECT_EQ(GpuMatmul(a, {M, K}, {K, 1},
+                        b, {K, N}, {1, K}),
+              CpuMatmul(a, {M, K}, {K, 1},
+                        b, {K, N}, {1, K}));
+    // matmul(a.T, b.T)
+    EXPECT_EQ(GpuMatmul(a, {M, K}, {1, M},
+                        b, {K, N}, {1, K}),
+              CpuMatmul(a, {M, K}, {1, M},
+                        b, {K, N}, {1, K}));
+  }
+}
+
+TEST_F(MatrixMultiplyTest, GEMMWithoutSubgroups) {
+  uint32_t M = 37, K = 70, N = 45;
+  auto a = RandomNumbers<float>(M * K, 10);
+  auto b = RandomNumbers<float>(K * N, 10);
+  for (bool disableSubgroups : {false, true}) {
+    SCOPED_TRACE(fmt::format("disableSubgroups: {}", disableSubgroups));
+    betann::Buffer out = CreateOutput<float>(M * N);
+    betann::GeneralMatrixMultiply(device_,
+                                  betann::DataType::F32,
+                                  {},
+                                  out,
+                                  M, N, K,
+                                  device_.CreateBufferFromVector(a),
+                                  false,
+                                  K,
+                                  {},
+                                  device_.CreateBufferFromVector(b),
+                                  false,
+                                  N,
+                                  {},
+                                  disableSubgroups);
+    device_.Flush();
+    EXPECT_EQ(ReadFromBuffer<float>(out, M * N),
+              CpuMatmul(a, {M, K}, {K, 1}, b, {K, N}, {N, 1}));
+  }
+}
+
+TEST_F(MatrixMultiplyTest, GEMMBatch) {
+  uint32_t M = 20, K = 33, N = 17;
+  auto a = RandomNumbers<int32_t>(6 * M * K, 10);
+  auto b = RandomNumbers<int32_t>(6 * K * N, 10);
+  // matmul(6, a, b)
+  EXPECT_EQ(GpuMatmul(a, {6, M, K}, {M * K, K, 1},
+                      b, {6, K, N}, {K * N, N, 1}),
+            CpuMatmul(a, {6, M, K}, {M * K, K, 1},
+                      b, {6, K, N}, {K * N, N, 1}));
+  // matmul(2, 3, a.T, b.T)
+  EXPECT_EQ(GpuMatmul(a, {2, 3, M, K}, {3 * M * K, M * K, 1, M},
+                      b, {2, 3, K, N}, {3 * K * N, K * N, 1, K}),
+            CpuMatmul(a, {2, 3, M, K}, {3 * M * K, M * K, 1, M},
+                      b, {2, 3, K, N}, {3 * K * N, K * N, 1, K}));
+  // matmul(6, a, b_broadcast), which collapses batches into M.
+  EXPECT_EQ(GpuMatmul(a, {6, M, K}, {M * K, K, 1},
+                      b, {6, K, N}, {0, N, 1}),
+            CpuMatmul(a, {6, M, K}, {M * K, K, 1},
+                      b, {6, K, N}, {0, N, 1}));
+  // matmul(2, 3, a_broadcast, b)
+  EXPECT_EQ(GpuMatmul(a, {2, 3, M, K}, {0, M * K, K, 1},
+                      b, {2, 3, K, N}, {3 * K * N, K * N, N, 1}),
+            CpuMatmul(a, {2, 3, M, K}, {0, M * K, K, 1},
+                      b, {2, 3, K, N}, {3 * K * N, K * N, N, 1}));
+}
+
+TEST_F(MatrixMultiplyTest, BroadcastBatch) {
+  uint32_t M = 20, K = 33, N = 17;
+  auto a = RandomNumbers<float>(6 * M * K, 10);
+  auto b = RandomNumbers<float>(6 * K * N, 10);
+  // matmul(2x3 a, b)
+  EXPECT_EQ(GpuMatmul(a, {2, 3, M, K}, {3 * M * K, M * K, K, 1},
+                      b, {K, N}, {N, 1}),
+            CpuMatmul(a, {2, 3, M, K}, {3 * M * K, M * K, K, 1},
+                      b, {2, 3, K, N}, {0, 0, N, 1}));
+  // matmul(a, 2x3 b.T)
+  EXPECT_EQ(GpuMatmul(a, {M, K}, {K, 1},
+                      b, {2, 3, K, N}, {3 * K * N, K * N, 1, K}),
+            CpuMatmul(a, {2, 3, M, K}, {0, 0, K, 1},
+                      b, {2, 3, K, N}, {3 * K * N, K * N, 1, K}));
+  // matmul(2x1 a.T, 3 b)
+  EXPECT_EQ(GpuMatmul(a, {2, 1, M, K}, {M * K, M * K, 1, M},
+                      b, {3, K, N}, {K * N, N, 1}),
+            CpuMatmul(a, {2, 3, M, K}, {M * K, 0, 1, M},
+                      b, {2, 3, K, N}, {0, K * N, N, 1}));
+  // matmul(2x3 a, 3 vector)
+  EXPECT_EQ(GpuMatmul(a, {2, 3, M, K}, {3 * M * K, M * K, K, 1},
+                      b, {3, K, 1}, {K, 1, 1}),
+            CpuMatmul(a, {2, 3, M, K}, {3 * M * K, M * K, K, 1},
+                      b, {2, 3, K, 1}, {0, K, 1, 1}));
+  // matmul(2x1 vector, 3 b), where the vector needs a copy.
+  EXPECT_EQ(GpuMatmul(a, {2, 1, 1, K}, {M * K, M * K, 1, 2},
+                      b, {3, K, N}, {K * N, N, 1}),
+            CpuMatmul(a, {2, 3, 1, K}, {M * K, 0, 1, 2},
+                      b, {2, 3, K, N}, {0, K * N, N, 1}));
+}
+
+TEST_F(MatrixMultiplyTest, GEMMSplitK) {
+  uint32_t M = 40, K = 8192, N = 33;
+  auto a = RandomNumbers<float>(2 * M * K, 10);
+  auto b = RandomNumbers<float>(K * N, 10);
+  EXPECT_EQ(GpuMatmul(a, {2, M, K}, {M * K, 1, M},
+                      b, {K, N}, {N, 1}),
+            CpuMatmul(a, {2, M, K}, {M * K, 1, M},
+                      b, {2, K, N}, {0, N, 1}));
+}
+
+TEST_F(MatrixMultiplyTest, Epilogue) {
+  auto cpuEpilogue = [](std::vector<float> result,
+                        const std::vector<float>& bias,
+                        const std::vector<float>& residual) {
+    for (size_t i = 0; i < result.size(); ++i)
+      result[i] = -(2 * result[i] + 3 * residual[i] + bias[i % bias.size()]);
+    return result;
+  };
+  for (auto [M, N, K] : {std::tuple<uint32_t, uint32_t, uint32_t>{33, 40, 10},
+                        {1, 40, 10},
+                        {33, 1, 10},
+                        {1, 8, 4096}}) {
+    SCOPED_TRACE(fmt::format("M: {}, N: {}, K: {}", M, N, K));
+    auto a = RandomNumbers<float>(M * K, 10);
+    auto b = RandomNumbers<float>(K * N, 10);
+    auto bias = RandomNumbers<float>(N, 10);
+    auto residual = RandomNumbers<float>(M * N, 10);
+    betann::MatmulEpilogue epilogue;
+    epilogue.alpha = 2;
+    epilogue.beta = 3;
+    epilogue.bias = device_.CreateBufferFromVector(bias);
+    epilogue.residual = device_.CreateBufferFromVector(residual);
+    epilogue.activation = "negative";
+    EXPECT_EQ(GpuMatmul(a, {M, K}, {K, 1},
+                        b, {K, N}, {N, 1},
+                        epilogue),
+              cpuEpilogue(CpuMatmul(a, {M, K}, {K, 1},
+                                    b, {K, N}, {N, 1}),
+                          bias, residual));
+    EXPECT_EQ(GpuMatmul(a, {M, K}, {1, M},
+                        b, {K, N}, {1, K},
+                        epilogue),
+              cpuEpilogue(CpuMatmul(a, {M, K}, {1, M},
+                                    b, {K, N}, {1, K}),
+                          bias, residual));
+  }
+}
+
+TEST_F(MatrixMultiplyTest, EpilogueActivation) {
+  uint32_t M = 20, N = 30, K = 8;
+  auto a = Map(RandomNumbers<float>(M * K, 10), [](float x) { return x / 8; });
+  auto b = Map(RandomNumbers<float>(K * N, 10), [](float x) { return -x / 8; });
+  auto c = CpuMatmul(a, {M, K}, {K, 1}, b, {K, N}, {N, 1});
+  for (const char* activation : {"silu", "gelu"}) {
+    SCOPED_TRACE(activation);
+    betann::MatmulEpilogue epilogue;
+    epilogue.activation = activation;
+    auto result = GpuMatmul(a, {M, K}, {K, 1}, b, {K, N}, {N, 1}, epilogue);
+    for (size_t i = 0; i < c.size(); ++i) {
+      float x = c[i];
+      float expected = activation == std::string("silu")
+          ? x / (1 + std::exp(-x))
+          : x * (1 + std::erf(x / std::sqrt(2.f))) / 2;
+      EXPECT_NEAR(result[i], expected, 1e-3 * std::max(1.f, std::abs(x)));
+    }
+  }
+}
+
+TEST_F(MatrixMultiplyTest, EpilogueActivationIntegers) {
+  betann::MatmulEpilogue epilogue;
+  epilogue.activation = "silu";
+  auto a = RandomNumbers<int32_t>(8 * 8, 10);
+  EXPECT_THROW(GpuMatmul(a, {8, 8}, {8, 1}, a, {8, 8}, {8, 1}, epilogue),
+               std::runtime_error);
+}
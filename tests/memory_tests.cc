@@ -0,0 +1,85 @@
+#include "betann_tests.h"
+
+#include "betann/reduce.h"
+
+TEST_F(BetaNNTests, MemoryUsage) {
+  betann::MemoryUsage initial = device_.GetMemoryUsage();
+  {
+    betann::Buffer a = device_.CreateBuffer(1024, betann::BufferUsage::Storage);
+    betann::Buffer copy = a;
+    EXPECT_EQ(device_.GetMemoryUsage().current, initial.current + 1024);
+    EXPECT_EQ(
+        device_.GetMemoryUsage(betann::MemoryCategory::UserBuffers).current,
+        initial.current + 1024);
+    a = nullptr;
+    // Still referenced by the copy.
+    EXPECT_EQ(device_.GetMemoryUsage().current, initial.current + 1024);
+  }
+  EXPECT_EQ(device_.GetMemoryUsage().current, initial.current);
+  EXPECT_EQ(device_.GetMemoryUsage().peak, initial.current + 1024);
+  device_.ResetPeakMemoryUsage();
+  EXPECT_EQ(device_.GetMemoryUsage().peak, initial.current);
+}
+
+TEST_F(BetaNNTests, MemoryCategories) {
+  auto input = RandomNumbers<float>(1 << 20);
+  betann::Buffer inputBuffer = device_.CreateBufferFromData(
+      input.data(), input.size() * sizeof(float));
+  betann::Buffer output = device_.CreateBuffer(
+      sizeof(float),
+      betann::BufferUsage::Storage | betann::BufferUsage::CopySrc);
+  EXPECT_EQ(
+      device_.GetMemoryUsage(betann::MemoryCategory::Parameters).peak, 0);
+  // The uniforms of ops are accounted as parameters without any scope.
+  betann::ReduceAll(device_,
+                    betann::ReduceType::Sum,
+                    betann::DataType::F32,
+                    output,
+                    betann::DataType::F32,
+                    inputBuffer,
+                    input.size());
+  EXPECT_GT(
+      device_.GetMemoryUsage(betann::MemoryCategory::Parameters).peak, 0);
+  EXPECT_GT(
+      device_.GetMemoryUsage(betann::MemoryCategory::Intermediates).peak, 0);
+  EXPECT_EQ(
+      device_.GetMemoryUsage(betann::MemoryCategory::Staging).peak, 0);
+  ReadFromBuffer<float>(output, 1);
+  EXPECT_EQ(
+      device_.GetMemoryUsage(betann::MemoryCategory::Staging).peak,
+      sizeof(float));
+}
+
+TEST_F(BetaNNTests, MemoryBudget) {
+  uint64_t current = device_.GetMemoryUsage().current;
+  std::vector<uint64_t> reports;
+  device_.SetSoftMemoryBudget(current + 1000, [&](uint64_t usage) {
+    reports.push_back(usage);
+  });
+  device_.SetMemoryBudget(current + 2000);
+  betann::Buffer a = device_.CreateBuffer(800, betann::BufferUsage::Storage);
+  EXPECT_TRUE(reports.empty());
+  betann::Buffer b = device_.CreateBuffer(800, betann::BufferUsage::Storage);
+  EXPECT_EQ(reports, std::vector<uint64_t>{current + 1600});
+  EXPECT_THROW(device_.CreateBuffer(800, betann::BufferUsage::Storage),
+               std::runtime_error);
+  b = nullptr;
+  betann::Buffer c = device_.CreateBuffer(800, betann::BufferUsage::Storage);
+  EXPECT_EQ(reports.size(), 2);
+}
+
+TEST_F(BetaNNTests, MemoryReleasedAfterSubmission) {
+  uint64_t initial =
+      device_.GetMemoryUsage(betann::MemoryCategory::Parameters).current;
+  betann::Buffer output = device_.CreateBuffer(
+      sizeof(float) * 64,
+      betann::BufferUsage::Storage | betann::BufferUsage::CopySrc);
+  betann::ArrayRange(device_, 0, 1, betann::DataType::F32, output);
+  // The parameter buffers are still used by the unfinished commands.
+  EXPECT_GT(device_.GetMemoryUsage(betann::MemoryCategory::Parameters).current,
+            initial);
+  device_.Flush();
+  device_.WaitAll();
+  EXPECT_EQ(device_.GetMemoryUsage(betann::MemoryCategory::Parameters).current,
+            initial);
+}
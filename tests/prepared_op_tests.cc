@@ -0,0 +1,63 @@
+#include "betann_tests.h"
+
+#include "betann/prepared_op.h"
+
+class PreparedOpTests : public BetaNNTests {};
+
+TEST_F(PreparedOpTests, BinaryOpGeneral) {
+  std::vector<uint32_t> shape = {3, 4};
+  betann::PreparedOp op = betann::PrepareBinaryOpGeneral(
+      device_, "add", betann::DataType::I32, CreateOutput<int32_t>(12), shape,
+      betann::DataType::I32,
+      CreateOutput<int32_t>(12), {1, 3},
+      CreateOutput<int32_t>(4), {0, 1});
+  for (int r = 0; r < 2; ++r) {
+    auto a = RandomNumbers<int32_t>(12);
+    auto b = RandomNumbers<int32_t>(4);
+    betann::Buffer out = CreateOutput<int32_t>(12);
+    op.Run({device_.CreateBufferFromVector(a),
+            device_.CreateBufferFromVector(b)},
+           {out});
+    device_.Flush();
+    std::vector<int32_t> expected;
+    for (uint32_t i = 0; i < 3; ++i) {
+      for (uint32_t j = 0; j < 4; ++j)
+        expected.push_back(a[i + j * 3] + b[j]);
+    }
+    EXPECT_EQ(ReadFromBuffer<int32_t>(out, 12), expected);
+  }
+}
+
+TEST_F(PreparedOpTests, UnaryOpGeneral) {
+  betann::PreparedOp op = betann::PrepareUnaryOpGeneral(
+      device_, "negative", betann::DataType::I32, CreateOutput<int32_t>(6),
+      betann::DataType::I32, CreateOutput<int32_t>(12), {3, 2}, {4, 2});
+  auto a = RandomNumbers<int32_t>(12);
+  betann::Buffer out = CreateOutput<int32_t>(6);
+  op.Run({device_.CreateBufferFromVector(a)}, {out});
+  device_.Flush();
+  EXPECT_EQ(ReadFromBuffer<int32_t>(out, 6),
+            (std::vector<int32_t>{-a[0], -a[2], -a[4], -a[6], -a[8], -a[10]}));
+  EXPECT_THROW(op.Run({}, {out}), std::runtime_error);
+}
+
+TEST_F(PreparedOpTests, MatrixMultiply) {
+  uint32_t M = 1, K = 33, N = 17;
+  // Use transposed |b| to cover the stride analysis.
+  std::vector<uint32_t> bStrides = {1, K};
+  betann::PreparedOp op = betann::PrepareMatrixMultiply(
+      device_, betann::DataType::F32, CreateOutput<float>(M * N),
+      CreateOutput<float>(M * K), {M, K}, {K, 1},
+      CreateOutput<float>(K * N), {K, N}, bStrides);
+  for (int r = 0; r < 2; ++r) {
+    auto a = RandomNumbers<float>(M * K, 10);
+    auto b = RandomNumbers<float>(K * N, 10);
+    betann::Buffer out = CreateOutput<float>(M * N);
+    op.Run({device_.CreateBufferFromVector(a),
+            device_.CreateBufferFromVector(b)},
+           {out});
+    device_.Flush();
+    EXPECT_EQ(ReadFromBuffer<float>(out, M * N),
+              CpuMatmul(a, {M, K}, {K, 1}, b, {K, N}, bStrides));
+  }
+}
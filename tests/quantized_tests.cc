@@ -0,0 +1,190 @@
+#include "betann_tests.h"
+
+#include <fmt/format.h>
+
+#include "betann/matmul.h"
+
+class QuantizedTests : public BetaNNTests {
+ public:
+  // A quantized matrix and its dequantized values.
+  struct Quantized {
+    std::vector<uint32_t> packed;
+    std::vector<float> scales;
+    std::vector<float> biases;
+    std::vector<float> dequantized;
+  };
+
+  Quantized RandomQuantized(uint32_t rows,
+                            uint32_t cols,
+                            uint32_t groupSize,
+                            uint32_t bits) {
+    Quantized q;
+    auto values = RandomNumbers<uint32_t>(rows * cols, (1 << bits) - 1, 0);
+    q.scales = RandomNumbers<float>(rows * cols / groupSize, 4, 1);
+    q.biases = RandomNumbers<float>(rows * cols / groupSize, 4, -4);
+    // Pack the values as bitstream.
+    q.packed.resize(rows * cols * bits / 32, 0);
+    for (size_t i = 0; i < values.size(); ++i) {
+      size_t bit = i * bits;
+      q.packed[bit / 32] |= values[i] << (bit % 32);
+      if (bit % 32 + bits > 32)
+        q.packed[bit / 32 + 1] |= values[i] >> (32 - bit % 32);
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+      size_t group = i / groupSize;
+      q.dequantized.push_back(q.scales[group] * values[i] + q.biases[group]);
+    }
+    return q;
+  }
+
+  std::vector<float> GpuQuantizedGemv(const Quantized& q,
+                                      bool transpose,
+                                      uint32_t rows,
+                                      uint32_t cols,
+                                      uint32_t groupSize,
+                                      uint32_t bits,
+                                      const std::vector<float>& vec,
+                                      uint32_t batchSize,
+                                      bool disableSubgroups) {
+    uint32_t outSize = batchSize * (transpose ? cols : rows);
+    betann::Buffer out = device_.CreateBuffer(
+        outSize * sizeof(float),
+        betann::BufferUsage::Storage | betann::BufferUsage::CopySrc);
+    betann::QuantizedMatrixVectorMultiply(
+        device_,
+        betann::DataType::F32,
+        batchSize,
+        out,
+        device_.CreateBufferFromVector(q.packed),
+        transpose,
+        rows,
+        cols,
+        device_.CreateBufferFromVector(q.scales),
+        device_.CreateBufferFromVector(q.biases),
+        groupSize,
+        bits,
+        device_.CreateBufferFromVector(vec),
+        disableSubgroups);
+    device_.Flush();
+    return ReadFromBuffer<float>(out, outSize);
+  }
+
+  std::vector<float> GpuQuantizedMatmul(const Quantized& q,
+                                        bool transpose,
+                                        uint32_t rows,
+                                        uint32_t cols,
+                                        uint32_t groupSize,
+                                        uint32_t bits,
+                                        const std::vector<float>& x,
+                                        uint32_t M,
+                                        bool disableSubgroups) {
+    uint32_t outSize = M * (transpose ? cols : rows);
+    betann::Buffer out = device_.CreateBuffer(
+        outSize * sizeof(float),
+        betann::BufferUsage::Storage | betann::BufferUsage::CopySrc);
+    betann::QuantizedMatrixMultiply(
+        device_,
+        betann::DataType::F32,
+        out,
+        M,
+        device_.CreateBufferFromVector(x),
+        device_.CreateBufferFromVector(q.packed),
+        transpose,
+        rows,
+        cols,
+        device_.CreateBufferFromVector(q.scales),
+        device_.CreateBufferFromVector(q.biases),
+        groupSize,
+        bits,
+        disableSubgroups);
+    device_.Flush();
+    return ReadFromBuffer<float>(out, outSize);
+  }
+
+  std::vector<bool> GetParameters() {
+    std::vector<bool> disableSubgroups{true};
+    if (device_.SupportsSubgroups())
+      disableSubgroups.push_back(false);
+    return disableSubgroups;
+  }
+};
+
+TEST_F(QuantizedTests, MatrixVectorMultiply) {
+  for (bool disableSubgroups : GetParameters()) {
+    for (uint32_t bits : {2, 3, 4, 6, 8}) {
+      for (auto [rows, cols, groupSize, batch] :
+               {std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>{1, 32, 32, 1},
+                {5, 64, 32, 1},
+                {33, 96, 32, 2},
+                {70, 512, 64, 3},
+                {4100, 256, 128, 1}}) {
+        SCOPED_TRACE(fmt::format("bits: {}, rows: {}, cols: {}, group: {}, "
+                                 "batch: {}, disableSubgroups: {}",
+                                 bits, rows, cols, groupSize, batch,
+                                 disableSubgroups));
+        Quantized q = RandomQuantized(rows, cols, groupSize, bits);
+        auto vec = RandomNumbers<float>(batch * cols, 10);
+        EXPECT_EQ(GpuQuantizedGemv(q, false, rows, cols, groupSize, bits,
+                                   vec, batch, disableSubgroups),
+                  CpuMatmul(q.dequantized, {batch, rows, cols},
+                            {0, cols, 1},
+                            vec, {batch, cols, 1}, {cols, 1, 1}));
+      }
+    }
+  }
+}
+
+TEST_F(QuantizedTests, MatrixVectorMultiplyTranspose) {
+  for (bool disableSubgroups : GetParameters()) {
+    for (uint32_t bits : {2, 3, 4, 6, 8}) {
+      for (auto [rows, cols, groupSize, batch] :
+               {std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>{1, 32, 32, 1},
+                {5, 64, 32, 1},
+                {33, 96, 32, 2},
+                {70, 640, 64, 3},
+                {100, 2048, 128, 1}}) {
+        SCOPED_TRACE(fmt::format("bits: {}, rows: {}, cols: {}, group: {}, "
+                                 "batch: {}, disableSubgroups: {}",
+                                 bits, rows, cols, groupSize, batch,
+                                 disableSubgroups));
+        Quantized q = RandomQuantized(rows, cols, groupSize, bits);
+        auto vec = RandomNumbers<float>(batch * rows, 10);
+        EXPECT_EQ(GpuQuantizedGemv(q, true, rows, cols, groupSize, bits,
+                                   vec, batch, disableSubgroups),
+                  CpuMatmul(vec, {batch, 1, rows}, {rows, rows, 1},
+                            q.dequantized, {batch, rows, cols},
+                            {0, cols, 1}));
+      }
+    }
+  }
+}
+
+TEST_F(QuantizedTests, MatrixMultiply) {
+  for (bool disableSubgroups : GetParameters()) {
+    for (uint32_t bits : {2, 3, 4, 6, 8}) {
+      for (auto [M, rows, cols, groupSize] :
+               {std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>{8, 1, 32, 32},
+                {9, 70, 64, 32},
+                {70, 33, 96, 32},
+                {130, 100, 256, 128}}) {
+        SCOPED_TRACE(fmt::format("bits: {}, M: {}, rows: {}, cols: {}, "
+                                 "group: {}, disableSubgroups: {}",
+                                 bits, M, rows, cols, groupSize,
+                                 disableSubgroups));
+        Quantized q = RandomQuantized(rows, cols, groupSize, bits);
+        // x @ mat.T
+        auto x = RandomNumbers<float>(M * cols, 10);
+        EXPECT_EQ(GpuQuantizedMatmul(q, false, rows, cols, groupSize, bits,
+                                     x, M, disableSubgroups),
+                  CpuMatmul(x, {M, cols}, {cols, 1},
+                            q.dequantized, {cols, rows}, {1, cols}));
+        // x @ mat
+        auto xt = RandomNumbers<float>(M * rows, 10);
+        EXPECT_EQ(GpuQuantizedMatmul(q, true, rows, cols, groupSize, bits,
+                                     xt, M, disableSubgroups),
+                  CpuMatmul(xt, {M, rows}, {rows, 1},
+                            q.dequantized, {rows, cols}, {cols, 1}));
+      }
+    }
+  }
+}
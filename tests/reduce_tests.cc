@@ -1,5 +1,8 @@
 #include "betann_tests.h"
 
+#include <cmath>
+#include <limits>
+
 #include <fmt/format.h>
 
 #include "betann/reduce.h"
@@ -9,7 +12,8 @@ class ReduceTests : public BetaNNTests {
   template<typename T, typename U>
   T RunReduceAll(betann::ReduceType type,
                  const std::vector<U>& input,
-                 bool disableSubgroups = false) {
+                 bool disableSubgroups = false,
+                 const betann::ReducePrologue& prologue = {}) {
     betann::Buffer output = device_.CreateBuffer(
         sizeof(T),
         betann::BufferUsage::Storage | betann::BufferUsage::CopySrc);
@@ -20,35 +24,50 @@ class ReduceTests : public BetaNNTests {
                       betann::GetDataType<U>(),
                       device_.CreateBufferFromVector(input),
                       input.size(),
-                      disableSubgroups);
+                      disableSubgroups,
+                      {},
+                      prologue);
     device_.Flush();
     return ReadFromBuffer<T>(output, 1)[0];
   }
 
+  // Create the output of reducing |axes| of |shape|, pass it with its number
+  // of elements to |run|, and read it back after flushing.
+  template<typename T, typename F>
+  std::vector<T> RunWithOutput(const std::vector<uint32_t>& shape,
+                               const std::vector<uint32_t>& axes,
+                               F&& run) {
+    uint32_t outputNumElements =
+        betann::NumElements(betann::RemoveIndices(shape, axes));
+    betann::Buffer output = CreateOutput<T>(outputNumElements);
+    run(output, outputNumElements);
+    device_.Flush();
+    return ReadFromBuffer<T>(output, outputNumElements);
+  }
+
   template<typename T, typename U>
   std::vector<T> RunReduceLast(betann::ReduceType type,
                                const std::vector<U>& input,
                                const std::vector<uint32_t>& shape,
                                const std::vector<uint32_t>& axes,
-                               bool disableSubgroups = false) {
-    uint32_t outputNumElements =
-        betann::NumElements(betann::RemoveIndices(shape, axes));
+                               bool disableSubgroups = false,
+                               const betann::ReducePrologue& prologue = {}) {
     uint32_t rowSize =
         betann::NumElements(betann::KeepIndices(shape, axes));
-    betann::Buffer output = device_.CreateBuffer(
-        outputNumElements * sizeof(T),
-        betann::BufferUsage::Storage | betann::BufferUsage::CopySrc);
-    betann::ReduceLast(device_,
-                       type,
-                       betann::GetDataType<T>(),
-                       output,
-                       outputNumElements,
-                       betann::GetDataType<U>(),
-                       device_.CreateBufferFromVector(input),
-                       rowSize,
-                       disableSubgroups);
-    device_.Flush();
-    return ReadFromBuffer<T>(output, outputNumElements);
+    return RunWithOutput<T>(shape, axes, [&](const betann::Buffer& output,
+                                             uint32_t outputNumElements) {
+      betann::ReduceLast(device_,
+                         type,
+                         betann::GetDataType<T>(),
+                         output,
+                         outputNumElements,
+                         betann::GetDataType<U>(),
+                         device_.CreateBufferFromVector(input),
+                         rowSize,
+                         disableSubgroups,
+                         {},
+                         prologue);
+    });
   }
 
   template<typename T, typename U>
@@ -57,27 +76,119 @@ class ReduceTests : public BetaNNTests {
                               const std::vector<uint32_t>& shape,
                               const std::vector<uint32_t>& strides,
                               const std::vector<uint32_t>& axes,
-                              bool disableSubgroups = false) {
-    uint32_t outputNumElements =
-        betann::NumElements(betann::RemoveIndices(shape, axes));
-    betann::Buffer output = device_.CreateBuffer(
-        outputNumElements * sizeof(T),
-        betann::BufferUsage::Storage | betann::BufferUsage::CopySrc);
-    betann::ReduceRow(device_,
-                      type,
-                      betann::GetDataType<T>(),
-                      output,
-                      outputNumElements,
-                      betann::GetDataType<U>(),
-                      device_.CreateBufferFromVector(input),
-                      shape,
-                      strides,
-                      axes,
-                      betann::KeepIndices(shape, axes),
-                      betann::KeepIndices(strides, axes),
-                      disableSubgroups);
-    device_.Flush();
-    return ReadFromBuffer<T>(output, outputNumElements);
+                              bool disableSubgroups = false,
+                              const betann::ReducePrologue& prologue = {}) {
+    return RunWithOutput<T>(shape, axes, [&](const betann::Buffer& output,
+                                             uint32_t outputNumElements) {
+      betann::ReduceRow(device_,
+                        type,
+                        betann::GetDataType<T>(),
+                        output,
+                        outputNumElements,
+                        betann::GetDataType<U>(),
+                        device_.CreateBufferFromVector(input),
+                        shape,
+                        strides,
+                        axes,
+                        betann::KeepIndices(shape, axes),
+                        betann::KeepIndices(strides, axes),
+                        disableSubgroups,
+                        {},
+                        prologue);
+    });
+  }
+
+  template<typename T, typename U>
+  std::vector<T> RunReduceCol(betann::ReduceType type,
+                              const std::vector<U>& input,
+                              const std::vector<uint32_t>& shape,
+                              const std::vector<uint32_t>& strides,
+                              const std::vector<uint32_t>& axes,
+                              bool disableSubgroups = false,
+                              const betann::ReducePrologue& prologue = {}) {
+    return RunWithOutput<T>(shape, axes, [&](const betann::Buffer& output,
+                                             uint32_t outputNumElements) {
+      betann::ReduceCol(device_,
+                        type,
+                        betann::GetDataType<T>(),
+                        output,
+                        outputNumElements,
+                        betann::GetDataType<U>(),
+                        device_.CreateBufferFromVector(input),
+                        shape,
+                        strides,
+                        axes,
+                        betann::KeepIndices(shape, axes),
+                        betann::KeepIndices(strides, axes),
+                        disableSubgroups,
+                        prologue);
+    });
+  }
+
+  template<typename T, typename U>
+  std::vector<T> RunReduceGeneral(betann::ReduceType type,
+                                  const std::vector<U>& input,
+                                  const std::vector<uint32_t>& shape,
+                                  const std::vector<uint32_t>& strides,
+                                  const std::vector<uint32_t>& axes,
+                                  bool disableSubgroups = false) {
+    return RunWithOutput<T>(shape, axes, [&](const betann::Buffer& output,
+                                             uint32_t outputNumElements) {
+      betann::ReduceGeneral(device_,
+                            type,
+                            betann::GetDataType<T>(),
+                            output,
+                            outputNumElements,
+                            betann::GetDataType<U>(),
+                            device_.CreateBufferFromVector(input),
+                            shape,
+                            strides,
+                            axes,
+                            betann::KeepIndices(shape, axes),
+                            betann::KeepIndices(strides, axes),
+                            disableSubgroups);
+    });
+  }
+
+  // Run reduce that also writes values with |kernel| of "all", "last" or "row",
+  // and return the outputs and the values.
+  template<typename T, typename V, typename U>
+  std::pair<std::vector<T>, std::vector<V>> RunReduceWithValues(
+      const char* kernel,
+      betann::ReduceType type,
+      const std::vector<U>& input,
+      const std::vector<uint32_t>& shape,
+      const std::vector<uint32_t>& axes,
+      bool disableSubgroups = false) {
+    betann::Buffer values = CreateOutput<V>(
+        betann::NumElements(betann::RemoveIndices(shape, axes)));
+    betann::Buffer inputBuffer = device_.CreateBufferFromVector(input);
+    auto outputs = RunWithOutput<T>(shape, axes, [&](
+        const betann::Buffer& output, uint32_t outputNumElements) {
+      if (std::string_view(kernel) == "all") {
+        betann::ReduceAll(device_, type,
+                          betann::GetDataType<T>(), output,
+                          betann::GetDataType<U>(), inputBuffer, input.size(),
+                          disableSubgroups, values);
+      } else if (std::string_view(kernel) == "last") {
+        betann::ReduceLast(device_, type,
+                           betann::GetDataType<T>(), output, outputNumElements,
+                           betann::GetDataType<U>(), inputBuffer,
+                           betann::NumElements(
+                               betann::KeepIndices(shape, axes)),
+                           disableSubgroups, values);
+      } else {
+        auto strides = Strides(shape);
+        betann::ReduceRow(device_, type,
+                          betann::GetDataType<T>(), output, outputNumElements,
+                          betann::GetDataType<U>(), inputBuffer,
+                          shape, strides, axes,
+                          betann::KeepIndices(shape, axes),
+                          betann::KeepIndices(strides, axes),
+                          disableSubgroups, values);
+      }
+    });
+    return {outputs, ReadFromBuffer<V>(values, outputs.size())};
   }
 
   template<typename T>
@@ -102,30 +213,49 @@ class ReduceTests : public BetaNNTests {
                            const std::vector<uint32_t>& shape,
                            const std::vector<uint32_t>& strides,
                            const std::vector<uint32_t>& axes) {
-    uint32_t outputNumElements =
-        betann::NumElements(betann::RemoveIndices(shape, axes));
-    betann::Buffer output = device_.CreateBuffer(
-        outputNumElements * sizeof(T),
-        betann::BufferUsage::Storage | betann::BufferUsage::CopySrc);
     betann::ReductionPlan plan = {
       planType,
       betann::KeepIndices(shape, axes),
       betann::KeepIndices(strides, axes),
     };
-    betann::Reduce(device_,
-                   std::move(plan),
-                   type,
-                   betann::GetDataType<T>(),
-                   output,
-                   outputNumElements,
-                   betann::GetDataType<U>(),
-                   device_.CreateBufferFromVector(input),
-                   input.size(),
-                   shape,
-                   strides,
-                   axes);
-    device_.Flush();
-    return ReadFromBuffer<T>(output, outputNumElements);
+    return RunWithOutput<T>(shape, axes, [&](const betann::Buffer& output,
+                                             uint32_t outputNumElements) {
+      betann::Reduce(device_,
+                     std::move(plan),
+                     type,
+                     betann::GetDataType<T>(),
+                     output,
+                     outputNumElements,
+                     betann::GetDataType<U>(),
+                     device_.CreateBufferFromVector(input),
+                     input.size(),
+                     shape,
+                     strides,
+                     axes);
+    });
+  }
+
+  // Run Reduce with the plan derived from the shape/strides of input.
+  template<typename T, typename U>
+  std::vector<T> RunPlannedReduce(betann::ReduceType type,
+                                  const std::vector<U>& input,
+                                  const std::vector<uint32_t>& shape,
+                                  const std::vector<uint32_t>& strides,
+                                  const std::vector<uint32_t>& axes) {
+    return RunWithOutput<T>(shape, axes, [&](const betann::Buffer& output,
+                                             uint32_t outputNumElements) {
+      betann::Reduce(device_,
+                     type,
+                     betann::GetDataType<T>(),
+                     output,
+                     outputNumElements,
+                     betann::GetDataType<U>(),
+                     device_.CreateBufferFromVector(input),
+                     betann::NumElements(shape),
+                     shape,
+                     strides,
+                     axes);
+    });
   }
 
   std::vector<uint32_t> Strides(const std::vector<uint32_t>& shape) {
@@ -162,6 +292,125 @@ class ReduceTests : public BetaNNTests {
     return output;
   }
 
+  // Walk the coordinates of |shape| in row-major order, and call
+  // |visit(outIndex, inputIndex, reductionIndex)| for each element, which
+  // works for any strides.
+  template<typename F>
+  void ForEachElement(const std::vector<uint32_t>& shape,
+                      const std::vector<uint32_t>& strides,
+                      const std::vector<uint32_t>& axes,
+                      F&& visit) {
+    for (uint32_t i = 0; i < betann::NumElements(shape); ++i) {
+      uint32_t inputIndex = 0;
+      uint32_t outIndex = 0;
+      uint32_t reductionIndex = 0;
+      for (int32_t axis = shape.size() - 1, coord = i, outMultiplier = 1,
+                   reductionMultiplier = 1;
+           axis >= 0; --axis) {
+        uint32_t c = coord % shape[axis];
+        coord /= shape[axis];
+        inputIndex += c * strides[axis];
+        if (std::find(axes.begin(), axes.end(), axis) == axes.end()) {
+          outIndex += c * outMultiplier;
+          outMultiplier *= shape[axis];
+        } else {
+          reductionIndex += c * reductionMultiplier;
+          reductionMultiplier *= shape[axis];
+        }
+      }
+      visit(outIndex, inputIndex, reductionIndex);
+    }
+  }
+
+  template<typename T>
+  std::vector<T> StridedSum(const std::vector<T>& input,
+                            const std::vector<uint32_t>& shape,
+                            const std::vector<uint32_t>& strides,
+                            const std::vector<uint32_t>& axes) {
+    std::vector<T> output(
+        betann::NumElements(betann::RemoveIndices(shape, axes)), 0);
+    ForEachElement(shape, strides, axes,
+                   [&](uint32_t outIndex, uint32_t inputIndex, uint32_t) {
+      output[outIndex] += input[inputIndex];
+    });
+    return output;
+  }
+
+  // Arg reduce of contiguous input, the ties are resolved to first index.
+  template<typename T>
+  std::pair<std::vector<uint32_t>, std::vector<T>> ArgReduce(
+      betann::ReduceType type,
+      const std::vector<T>& input,
+      const std::vector<uint32_t>& shape,
+      const std::vector<uint32_t>& axes) {
+    uint32_t outputNumElements =
+        betann::NumElements(betann::RemoveIndices(shape, axes));
+    std::vector<uint32_t> indices(outputNumElements, 0);
+    std::vector<T> values(outputNumElements);
+    std::vector<bool> found(outputNumElements, false);
+    ForEachElement(shape, Strides(shape), axes,
+                   [&](uint32_t outIndex,
+                       uint32_t inputIndex,
+                       uint32_t reductionIndex) {
+      bool better = type == betann::ReduceType::ArgMin
+                        ? input[inputIndex] < values[outIndex]
+                        : input[inputIndex] > values[outIndex];
+      if (!found[outIndex] || better) {
+        found[outIndex] = true;
+        indices[outIndex] = reductionIndex;
+        values[outIndex] = input[inputIndex];
+      }
+    });
+    return {indices, values};
+  }
+
+  // Mean and population variance of contiguous input.
+  std::pair<std::vector<double>, std::vector<double>> MeanVariance(
+      const std::vector<float>& input,
+      const std::vector<uint32_t>& shape,
+      const std::vector<uint32_t>& axes) {
+    uint32_t outputNumElements =
+        betann::NumElements(betann::RemoveIndices(shape, axes));
+    uint32_t count = input.size() / std::max(outputNumElements, 1u);
+    std::vector<double> sums(outputNumElements, 0);
+    std::vector<double> squares(outputNumElements, 0);
+    ForEachElement(shape, Strides(shape), axes,
+                   [&](uint32_t outIndex, uint32_t inputIndex, uint32_t) {
+      double x = input[inputIndex];
+      sums[outIndex] += x;
+      squares[outIndex] += x * x;
+    });
+    std::vector<double> means(outputNumElements);
+    std::vector<double> variances(outputNumElements);
+    for (uint32_t i = 0; i < outputNumElements; ++i) {
+      means[i] = sums[i] / count;
+      variances[i] = squares[i] / count - means[i] * means[i];
+    }
+    return {means, variances};
+  }
+
+  // Logsumexp of contiguous input.
+  std::vector<double> LogSumExp(const std::vector<float>& input,
+                                const std::vector<uint32_t>& shape,
+                                const std::vector<uint32_t>& axes) {
+    uint32_t outputNumElements =
+        betann::NumElements(betann::RemoveIndices(shape, axes));
+    std::vector<std::vector<double>> rows(outputNumElements);
+    ForEachElement(shape, Strides(shape), axes,
+                   [&](uint32_t outIndex, uint32_t inputIndex, uint32_t) {
+      rows[outIndex].push_back(input[inputIndex]);
+    });
+    std::vector<double> output(outputNumElements);
+    for (uint32_t i = 0; i < outputNumElements; ++i) {
+      double max = *std::max_element(rows[i].begin(), rows[i].end());
+      double sum = 0;
+      for (double x : rows[i])
+        sum += std::exp(x - max);
+      output[i] = max + std::log(sum);
+    }
+    return output;
+  }
+
   std::vector<bool> GetParameters() {
     std::vector<bool> disableSubgroups{true};
     if (device_.SupportsSubgroups())
@@ -203,6 +452,24 @@ TEST_F(ReduceTests, ReduceAll) {
   }
 }
 
+TEST_F(ReduceTests, ReduceAllManyWorkgroups) {
+  // Large enough for the 1st pass to use thousands of workgroups.
+  const uint32_t size = (1 << 24) + 100;
+  for (bool disableSubgroups : GetParameters()) {
+    SCOPED_TRACE(fmt::format("Subgroups: {}", !disableSubgroups));
+    auto ints = RandomNumbers<int32_t>(size, 10);
+    EXPECT_EQ(RunReduceAll<int32_t>(betann::ReduceType::Sum, ints,
+                                    disableSubgroups),
+              std::accumulate(ints.begin(), ints.end(), 0));
+    // The partial results of arg reductions carry indices of input.
+    ints[size - 7] = 11;
+    ints[size - 3] = 11;
+    EXPECT_EQ(RunReduceAll<uint32_t>(betann::ReduceType::ArgMax, ints,
+                                     disableSubgroups),
+              size - 7);
+  }
+}
+
 TEST_F(ReduceTests, ReduceLast) {
   for (bool disableSubgroups : GetParameters()) {
     const uint32_t shapes[][2] = {
@@ -211,6 +478,14 @@ TEST_F(ReduceTests, ReduceLast) {
       {31, 15},
       {32, 16},
       {33, 17},
+      {100000, 1},
+      {70000, 3},
+      {5000, 16},
+      {3000, 33},
+      {1000, 128},
+      {70, 129},
+      {1, 50000},
+      {4, 9000},
       {33, 600},
       {33, 800},
       {33, 1100},
@@ -244,6 +519,8 @@ TEST_F(ReduceTests, ReduceRow) {
       {{31, 127, 127}, {1, 2}},
       {{33, 33, 33, 4}, {3}},
       {{33, 33, 33, 4}, {2, 3}},
+      {{2, 100000}, {1}},
+      {{3, 5, 20000}, {1, 2}},
       {{33, 33, 33, 4}, {1, 2, 3}},
       {{7, 7, 7, 7, 7, 7}, {1, 2, 3, 4, 5}},
     };
@@ -262,6 +539,340 @@ TEST_F(ReduceTests, ReduceRow) {
   }
 }
 
+TEST_F(ReduceTests, ReduceCol) {
+  for (bool disableSubgroups : GetParameters()) {
+    const std::tuple<std::vector<uint32_t>, std::vector<uint32_t>> shapes[] = {
+      {{1, 1}, {0}},
+      {{33, 65}, {0}},
+      {{65, 33}, {0}},
+      {{5000, 3}, {0}},
+      {{10000, 70}, {0}},
+      {{4, 31, 17}, {0, 1}},
+      {{31, 4, 127}, {0}},
+      {{7, 8, 9, 10}, {0, 2}},
+      {{3000, 2, 2}, {0, 1}},
+    };
+    for (const auto& [shape, axes] : shapes) {
+      SCOPED_TRACE(fmt::format("Subgroups: {}, shape: {}, axes: {}",
+                               !disableSubgroups,
+                               VecToString(shape),
+                               VecToString(axes)));
+      auto strides = Strides(shape);
+      auto ints = RandomNumbers<int32_t>(betann::NumElements(shape), 10);
+      EXPECT_EQ(RunReduceCol<int32_t>(betann::ReduceType::Sum,
+                                      ints, shape, strides, axes,
+                                      disableSubgroups),
+                Sum(ints, shape, strides, axes));
+    }
+    // Min of the columns.
+    auto floats = RandomNumbers<float>(3000 * 5);
+    std::vector<float> mins(5, std::numeric_limits<float>::max());
+    for (size_t i = 0; i < floats.size(); ++i)
+      mins[i % 5] = std::min(mins[i % 5], floats[i]);
+    EXPECT_EQ(RunReduceCol<float>(betann::ReduceType::Min,
+                                  floats, {3000, 5}, {5, 1}, {0},
+                                  disableSubgroups),
+              mins);
+  }
+}
+
+TEST_F(ReduceTests, ReduceColWide) {
+  // More strips of outputs than the limit of workgroups in one dimension.
+  uint32_t maxWorkgroups =
+      device_.GetLimits().maxComputeWorkgroupsPerDimension;
+  std::vector<uint32_t> shape = {2, maxWorkgroups * 32 + 100};
+  std::vector<uint32_t> axes = {0};
+  auto strides = Strides(shape);
+  auto ints = RandomNumbers<int32_t>(betann::NumElements(shape), 10);
+  EXPECT_EQ(RunReduceCol<int32_t>(betann::ReduceType::Sum,
+                                  ints, shape, strides, axes),
+            Sum(ints, shape, strides, axes));
+}
+
+TEST_F(ReduceTests, ReduceGeneral) {
+  for (bool disableSubgroups : GetParameters()) {
+    // Shapes with strides, which are not row-major.
+    const std::tuple<std::vector<uint32_t>,
+                     std::vector<uint32_t>,
+                     std::vector<uint32_t>> shapes[] = {
+      {{7, 8, 9}, {72, 9, 1}, {1}},
+      {{7, 8, 9}, {1, 7, 56}, {0}},
+      {{7, 8, 9}, {1, 7, 56}, {0, 2}},
+      {{7, 8, 9, 10}, {720, 90, 10, 1}, {0, 2}},
+      {{7, 8, 9, 10}, {1, 7, 56, 504}, {1, 3}},
+      {{100, 3, 30}, {90, 1, 3}, {0, 2}},
+      {{3, 700}, {1, 3}, {1}},
+      {{3, 20000}, {1, 3}, {1}},
+      {{2, 3, 4, 5, 6, 7}, {6, 240, 60, 12, 1, 720}, {0, 2, 4}},
+    };
+    for (const auto& [shape, strides, axes] : shapes) {
+      SCOPED_TRACE(fmt::format("Subgroups: {}, shape: {}, strides: {}, "
+                               "axes: {}",
+                               !disableSubgroups,
+                               VecToString(shape),
+                               VecToString(strides),
+                               VecToString(axes)));
+      auto ints = RandomNumbers<int32_t>(betann::NumElements(shape), 10);
+      EXPECT_EQ(RunReduceGeneral<int32_t>(betann::ReduceType::Sum,
+                                          ints, shape, strides, axes,
+                                          disableSubgroups),
+                StridedSum(ints, shape, strides, axes));
+    }
+  }
+}
+
+TEST_F(ReduceTests, ArgReduce) {
+  for (bool disableSubgroups : GetParameters()) {
+    for (auto type : {betann::ReduceType::ArgMin, betann::ReduceType::ArgMax}) {
+      // Small range of numbers so there are many ties.
+      for (uint32_t size : {1, 33, 129, 4100, 10000, 70000}) {
+        SCOPED_TRACE(fmt::format("Subgroups: {}, size: {}",
+                                 !disableSubgroups, size));
+        auto floats = RandomNumbers<float>(size, 100, -100);
+        EXPECT_EQ((RunReduceWithValues<uint32_t, float>(
+                      "all", type, floats, {size}, {0}, disableSubgroups)),
+                  ArgReduce(type, floats, {size}, {0}));
+      }
+      const std::tuple<const char*,
+                       std::vector<uint32_t>,
+                       std::vector<uint32_t>> shapes[] = {
+        {"last", {5, 1}, {1}},
+        {"last", {9, 33}, {1}},
+        {"last", {3, 1000}, {1}},
+        {"last", {2, 5000}, {1}},
+        {"last", {1, 20000}, {1}},
+        {"row", {5, 7}, {1}},
+        {"row", {7, 8, 9}, {1, 2}},
+        {"row", {8, 3, 700}, {1, 2}},
+        {"row", {3, 4, 5, 6}, {0, 2, 3}},
+      };
+      for (const auto& [kernel, shape, axes] : shapes) {
+        SCOPED_TRACE(fmt::format("Subgroups: {}, kernel: {}, shape: {}, "
+                                 "axes: {}",
+                                 !disableSubgroups,
+                                 kernel,
+                                 VecToString(shape),
+                                 VecToString(axes)));
+        auto ints = RandomNumbers<int32_t>(betann::NumElements(shape), 10, -10);
+        EXPECT_EQ((RunReduceWithValues<uint32_t, int32_t>(
+                      kernel, type, ints, shape, axes, disableSubgroups)),
+                  ArgReduce(type, ints, shape, axes));
+      }
+    }
+  }
+}
+
+TEST_F(ReduceTests, MeanVariance) {
+  const std::tuple<const char*,
+                   std::vector<uint32_t>,
+                   std::vector<uint32_t>> shapes[] = {
+    {"all", {1}, {0}},
+    {"all", {33}, {0}},
+    {"all", {4100}, {0}},
+    {"all", {100000}, {0}},
+    {"last", {5, 1}, {1}},
+    {"last", {70, 33}, {1}},
+    {"last", {3, 1000}, {1}},
+    {"last", {1, 20000}, {1}},
+    {"row", {5, 7}, {1}},
+    {"row", {7, 8, 9}, {1, 2}},
+    {"row", {3, 4, 5, 6}, {0, 2, 3}},
+  };
+  for (bool disableSubgroups : GetParameters()) {
+    for (const auto& [kernel, shape, axes] : shapes) {
+      SCOPED_TRACE(fmt::format("Subgroups: {}, kernel: {}, shape: {}, "
+                               "axes: {}",
+                               !disableSubgroups,
+                               kernel,
+                               VecToString(shape),
+                               VecToString(axes)));
+      // Values with a large mean, which the naive sum of squares would lose
+      // precision on.
+      auto floats =
+          RandomNumbers<float>(betann::NumElements(shape), 1010, 1000);
+      auto [expectedMeans, expectedVariances] =
+          MeanVariance(floats, shape, axes);
+      auto [means, variances] = RunReduceWithValues<float, float>(
+          kernel, betann::ReduceType::MeanVariance, floats, shape, axes,
+          disableSubgroups);
+      ASSERT_EQ(means.size(), expectedMeans.size());
+      for (size_t i = 0; i < means.size(); ++i) {
+        EXPECT_NEAR(means[i], expectedMeans[i], 1e-2);
+        EXPECT_NEAR(variances[i], expectedVariances[i], 1e-2);
+      }
+      if (device_.SupportsF16()) {
+        std::vector<uint16_t> halfs(floats.size());
+        std::vector<float> rounded(floats.size());
+        for (size_t i = 0; i < floats.size(); ++i) {
+          halfs[i] = betann::Float32ToFloat16(floats[i]);
+          rounded[i] = betann::Float16ToFloat32(halfs[i]);
+        }
+        auto [expectedMeans, expectedVariances] =
+            MeanVariance(rounded, shape, axes);
+        auto [means, variances] = RunReduceWithValues<float, float>(
+            kernel, betann::ReduceType::MeanVariance, halfs, shape, axes,
+            disableSubgroups);
+        for (size_t i = 0; i < means.size(); ++i) {
+          EXPECT_NEAR(means[i], expectedMeans[i], 1e-2);
+          EXPECT_NEAR(variances[i], expectedVariances[i], 1e-2);
+        }
+      }
+    }
+  }
+}
+
+TEST_F(ReduceTests, LogSumExp) {
+  for (bool disableSubgroups : GetParameters()) {
+    // Values that overflow exp in f32.
+    for (uint32_t size : {1, 33, 4100, 100000}) {
+      SCOPED_TRACE(fmt::format("Subgroups: {}, size: {}",
+                               !disableSubgroups, size));
+      auto floats = RandomNumbers<float>(size, 120, -20);
+      EXPECT_NEAR((RunReduceAll<float, float>(betann::ReduceType::LogSumExp,
+                                              floats, disableSubgroups)),
+                  LogSumExp(floats, {size}, {0})[0], 1e-3);
+    }
+    const std::tuple<const char*,
+                     std::vector<uint32_t>,
+                     std::vector<uint32_t>> shapes[] = {
+      {"last", {5, 1}, {1}},
+      {"last", {70, 33}, {1}},
+      {"last", {3, 1000}, {1}},
+      {"last", {1, 20000}, {1}},
+      {"row", {5, 7}, {1}},
+      {"row", {7, 8, 9}, {1, 2}},
+      {"row", {3, 4, 5, 6}, {0, 2, 3}},
+    };
+    for (const auto& [kernel, shape, axes] : shapes) {
+      SCOPED_TRACE(fmt::format("Subgroups: {}, kernel: {}, shape: {}, "
+                               "axes: {}",
+                               !disableSubgroups,
+                               kernel,
+                               VecToString(shape),
+                               VecToString(axes)));
+      auto floats = RandomNumbers<float>(betann::NumElements(shape), 120, -20);
+      std::vector<float> result;
+      if (std::string_view(kernel) == "last") {
+        result = RunReduceLast<float>(betann::ReduceType::LogSumExp,
+                                      floats, shape, axes, disableSubgroups);
+      } else {
+        result = RunReduceRow<float>(betann::ReduceType::LogSumExp,
+                                     floats, shape, Strides(shape), axes,
+                                     disableSubgroups);
+      }
+      auto expected = LogSumExp(floats, shape, axes);
+      ASSERT_EQ(result.size(), expected.size());
+      for (size_t i = 0; i < result.size(); ++i)
+        EXPECT_NEAR(result[i], expected[i], 1e-3);
+    }
+  }
+}
+
+TEST_F(ReduceTests, LogSumExpInfinities) {
+  const float inf = std::numeric_limits<float>::infinity();
+  for (bool disableSubgroups : GetParameters()) {
+    SCOPED_TRACE(fmt::format("Subgroups: {}", !disableSubgroups));
+    // Rows of all -inf, one +inf and all +inf.
+    const uint32_t rowSize = 300;
+    auto floats = RandomNumbers<float>(3 * rowSize, 120, -20);
+    std::fill_n(floats.begin(), rowSize, -inf);
+    floats[rowSize + 7] = inf;
+    std::fill_n(floats.begin() + 2 * rowSize, rowSize, inf);
+    std::vector<float> expected = {-inf, inf, inf};
+    EXPECT_EQ(RunReduceLast<float>(betann::ReduceType::LogSumExp,
+                                   floats, {3, rowSize}, {1},
+                                   disableSubgroups),
+              expected);
+    EXPECT_EQ(RunReduceRow<float>(betann::ReduceType::LogSumExp,
+                                  floats, {3, rowSize}, {rowSize, 1}, {1},
+                                  disableSubgroups),
+              expected);
+    // Reduced in 2 passes, whose partial results have infinite max.
+    std::vector<float> large(100000, -inf);
+    EXPECT_EQ((RunReduceAll<float, float>(betann::ReduceType::LogSumExp,
+                                          large, disableSubgroups)),
+              -inf);
+    large[5000] = inf;
+    large[90000] = inf;
+    EXPECT_EQ((RunReduceAll<float, float>(betann::ReduceType::LogSumExp,
+                                          large, disableSubgroups)),
+              inf);
+  }
+}
+
+TEST_F(ReduceTests, Prologue) {
+  for (bool disableSubgroups : GetParameters()) {
+    // Dot product.
+    for (uint32_t size : {1, 33, 4100, 100000}) {
+      SCOPED_TRACE(fmt::format("Subgroups: {}, size: {}",
+                               !disableSubgroups, size));
+      auto a = RandomNumbers<int32_t>(size, 10, -10);
+      auto b = RandomNumbers<int32_t>(size, 10, -10);
+      int32_t expected = 0;
+      for (uint32_t i = 0; i < size; ++i)
+        expected += a[i] * b[i];
+      betann::ReducePrologue dot{"multiply", device_.CreateBufferFromVector(b)};
+      EXPECT_EQ((RunReduceAll<int32_t>(betann::ReduceType::Sum,
+                                       a, disableSubgroups, dot)),
+                expected);
+    }
+    // Squared distance and L1 norm.
+    const std::tuple<const char*,
+                     std::vector<uint32_t>,
+                     std::vector<uint32_t>> shapes[] = {
+      {"last", {5, 1}, {1}},
+      {"last", {70, 33}, {1}},
+      {"last", {3, 1000}, {1}},
+      {"last", {1, 20000}, {1}},
+      {"row", {7, 8, 9}, {1, 2}},
+      {"row", {3, 4, 5, 6}, {0, 2, 3}},
+      {"col", {40, 100}, {0}},
+      {"col", {3000, 40}, {0}},
+    };
+    for (const auto& [kernel, shape, axes] : shapes) {
+      SCOPED_TRACE(fmt::format("Subgroups: {}, kernel: {}, shape: {}, "
+                               "axes: {}",
+                               !disableSubgroups,
+                               kernel,
+                               VecToString(shape),
+                               VecToString(axes)));
+      uint32_t size = betann::NumElements(shape);
+      auto a = RandomNumbers<int32_t>(size, 10, -10);
+      auto b = RandomNumbers<int32_t>(size, 10, -10);
+      std::vector<int32_t> squares(size);
+      std::vector<int32_t> absolutes(size);
+      for (uint32_t i = 0; i < size; ++i) {
+        squares[i] = (a[i] - b[i]) * (a[i] - b[i]);
+        absolutes[i] = std::abs(a[i]);
+      }
+      auto strides = Strides(shape);
+      betann::ReducePrologue distance{"subtract",
+                                      device_.CreateBufferFromVector(b),
+                                      "square"};
+      betann::ReducePrologue norm{nullptr, {}, "abs"};
+      for (const auto& [prologue, mapped] :
+               {std::make_pair(distance, squares),
+                std::make_pair(norm, absolutes)}) {
+        std::vector<int32_t> result;
+        if (std::string_view(kernel) == "last") {
+          result = RunReduceLast<int32_t>(betann::ReduceType::Sum,
+                                          a, shape, axes, disableSubgroups,
+                                          prologue);
+        } else if (std::string_view(kernel) == "row") {
+          result = RunReduceRow<int32_t>(betann::ReduceType::Sum,
+                                         a, shape, strides, axes,
+                                         disableSubgroups, prologue);
+        } else {
+          result = RunReduceCol<int32_t>(betann::ReduceType::Sum,
+                                         a, shape, strides, axes,
+                                         disableSubgroups, prologue);
+        }
+        EXPECT_EQ(result, Sum(mapped, shape, strides, axes));
+      }
+    }
+  }
+}
+
 TEST_F(ReduceTests, ReduceNone) {
   const uint32_t sizes[] = {1, 31, 32, 33, 127, 128, 129};
   for (uint32_t size : sizes) {
@@ -296,4 +907,96 @@ TEST_F(ReduceTests, Reduce) {
                                betann::ReduceType::Sum,
                                a, {2, 5}, {5, 1}, {1}),
             Sum(a, {2, 5}, {5, 1}, {1}));
+  EXPECT_EQ(RunReduce<int32_t>(betann::ReductionPlanType::ReduceCol,
+                               betann::ReduceType::Sum,
+                               a, {2, 5}, {5, 1}, {0}),
+            Sum(a, {2, 5}, {5, 1}, {0}));
+  EXPECT_EQ(RunReduce<int32_t>(betann::ReductionPlanType::ReduceGeneral,
+                               betann::ReduceType::Sum,
+                               a, {5, 2}, {1, 5}, {0}),
+            StridedSum(a, {5, 2}, {1, 5}, {0}));
+}
+
+TEST_F(ReduceTests, GetReductionPlan) {
+  using betann::ReductionPlanType;
+  const std::tuple<std::vector<uint32_t>,
+                   std::vector<uint32_t>,
+                   std::vector<uint32_t>,
+                   ReductionPlanType,
+                   std::vector<uint32_t>,
+                   std::vector<uint32_t>> cases[] = {
+    {{4, 5}, {5, 1}, {0, 1}, ReductionPlanType::ReduceAll, {}, {}},
+    {{4, 5}, {1, 4}, {0, 1}, ReductionPlanType::ReduceAll, {}, {}},
+    {{4, 5}, {5, 1}, {1}, ReductionPlanType::ReduceRow, {5}, {1}},
+    {{4, 5}, {5, 1}, {0}, ReductionPlanType::ReduceCol, {4}, {5}},
+    {{5, 2}, {1, 5}, {0}, ReductionPlanType::ReduceRow, {5}, {1}},
+    {{2, 3, 4}, {12, 4, 1}, {1, 2}, ReductionPlanType::ReduceRow, {12}, {1}},
+    {{2, 3, 4}, {12, 4, 1}, {0, 2}, ReductionPlanType::ReduceRow,
+     {2, 4}, {12, 1}},
+    {{2, 1, 4}, {4, 4, 1}, {0, 1}, ReductionPlanType::ReduceCol, {2}, {4}},
+    {{2, 1, 4}, {4, 4, 1}, {1}, ReductionPlanType::ReduceRow, {1}, {1}},
+    {{3, 4}, {0, 1}, {0}, ReductionPlanType::ReduceGeneral, {3}, {0}},
+    {{2, 3, 4}, {1, 8, 2}, {1, 2}, ReductionPlanType::ReduceGeneral,
+     {12}, {2}},
+    // Unsorted axes, where the reduction dims must not be counted as the
+    // contiguous non-reduction dims.
+    {{2, 2, 2}, {4, 1, 2}, {2, 0}, ReductionPlanType::ReduceCol, {4}, {2}},
+    {{2, 3, 4}, {12, 1, 3}, {2, 0}, ReductionPlanType::ReduceCol, {8}, {3}},
+  };
+  for (const auto& [shape, strides, axes, type, reductionShape,
+                    reductionStrides] : cases) {
+    SCOPED_TRACE(fmt::format("shape: {}, strides: {}, axes: {}",
+                             VecToString(shape),
+                             VecToString(strides),
+                             VecToString(axes)));
+    auto plan = betann::GetReductionPlan(shape, strides, axes);
+    EXPECT_EQ(plan.type, type);
+    EXPECT_EQ(plan.reductionShape, reductionShape);
+    EXPECT_EQ(plan.reductionStrides, reductionStrides);
+  }
+  // Transposed input is not contiguous for reductions keeping order.
+  auto plan = betann::GetReductionPlan({4, 5}, {1, 4}, {0, 1}, true);
+  EXPECT_NE(plan.type, ReductionPlanType::ReduceAll);
+  EXPECT_EQ(plan.reductionShape, (std::vector<uint32_t>{4, 5}));
+  EXPECT_EQ(plan.reductionStrides, (std::vector<uint32_t>{1, 4}));
+}
+
+TEST_F(ReduceTests, PlannedReduce) {
+  const std::tuple<std::vector<uint32_t>,
+                   std::vector<uint32_t>,
+                   std::vector<uint32_t>> shapes[] = {
+    {{4100}, {1}, {0}},
+    {{40, 50}, {1, 40}, {0, 1}},
+    {{40, 50}, {50, 1}, {1}},
+    {{40, 50}, {50, 1}, {0}},
+    {{40, 50}, {1, 40}, {0}},
+    {{6, 7, 8}, {56, 8, 1}, {0, 2}},
+    {{6, 7, 8}, {1, 48, 6}, {1, 2}},
+    {{30, 40}, {0, 1}, {0}},
+    {{3, 4, 5, 6}, {120, 30, 6, 1}, {0, 1, 3}},
+  };
+  for (const auto& [shape, strides, axes] : shapes) {
+    SCOPED_TRACE(fmt::format("shape: {}, strides: {}, axes: {}",
+                             VecToString(shape),
+                             VecToString(strides),
+                             VecToString(axes)));
+    uint32_t size = 1;
+    for (size_t i = 0; i < shape.size(); ++i)
+      size += (shape[i] - 1) * strides[i];
+    auto ints = RandomNumbers<int32_t>(size, 10, -10);
+    EXPECT_EQ(RunPlannedReduce<int32_t>(betann::ReduceType::Sum,
+                                        ints, shape, strides, axes),
+              StridedSum(ints, shape, strides, axes));
+  }
+  // The arg reductions keep the order of reduction dims.
+  auto floats = RandomNumbers<float>(40 * 50, 100, -100);
+  std::vector<float> transposed(floats.size());
+  for (uint32_t i = 0; i < 40; ++i) {
+    for (uint32_t j = 0; j < 50; ++j)
+      transposed[j * 40 + i] = floats[i * 50 + j];
+  }
+  EXPECT_EQ(RunPlannedReduce<uint32_t>(betann::ReduceType::ArgMax,
+                                       transposed, {40, 50}, {1, 40}, {0, 1}),
+            ArgReduce(betann::ReduceType::ArgMax, floats, {40, 50}, {0, 1})
+                .first);
 }
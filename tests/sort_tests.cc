@@ -1,5 +1,12 @@
 #include "betann_tests.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#include <fmt/format.h>
+
 class SortTests : public BetaNNTests {
  public:
   template<typename T>
@@ -50,11 +57,81 @@ class SortTests : public BetaNNTests {
     return ReadFromBuffer<uint32_t>(sortedIndices, inputNumElements);
   }
 
+  // Sort with betann::Sort, which uses multi-block merge sort or radix sort for
+  // axes longer than a block, and return the sorted values or indices
+  // depending on |resultType|.
+  template<betann::SortResultType resultType,
+           typename T,
+           typename R = std::conditional_t<
+               resultType == betann::SortResultType::Values, T, uint32_t>>
+  std::vector<R> RunMultiBlockSort(uint32_t axis,
+                                   betann::SortInputType inputType,
+                                   const std::vector<T>& input,
+                                   const std::vector<uint32_t>& shape,
+                                   const std::vector<uint32_t>& strides) {
+    uint32_t inputNumElements = betann::NumElements(shape, strides);
+    betann::Buffer out = CreateOutput<R>(inputNumElements);
+    betann::Sort(device_,
+                 axis,
+                 inputType,
+                 resultType,
+                 out,
+                 strides,
+                 betann::GetDataType<T>(),
+                 device_.CreateBufferFromVector(input),
+                 shape,
+                 strides);
+    device_.Flush();
+    return ReadFromBuffer<R>(out, inputNumElements);
+  }
+
+  // Return the values and indices of top k, which are in the order of indices.
+  template<typename T>
+  std::pair<std::vector<T>, std::vector<uint32_t>> RunTopK(
+      uint32_t axis,
+      uint32_t k,
+      const std::vector<T>& input,
+      const std::vector<uint32_t>& shape,
+      const std::vector<uint32_t>& strides) {
+    auto outShape = shape;
+    outShape[axis] = k;
+    std::vector<uint32_t> outStrides(shape.size());
+    uint32_t stride = 1;
+    for (size_t i = shape.size(); i > 0; --i) {
+      outStrides[i - 1] = stride;
+      stride *= outShape[i - 1];
+    }
+    uint32_t outNumElements = betann::NumElements(outShape);
+    betann::Buffer values = CreateOutput<T>(outNumElements);
+    betann::Buffer indices = CreateOutput<uint32_t>(outNumElements);
+    betann::TopK(device_,
+                 axis,
+                 k,
+                 values,
+                 indices,
+                 outStrides,
+                 betann::GetDataType<T>(),
+                 device_.CreateBufferFromVector(input),
+                 shape,
+                 strides);
+    device_.Flush();
+    return {ReadFromBuffer<T>(values, outNumElements),
+            ReadFromBuffer<uint32_t>(indices, outNumElements)};
+  }
+
   template<typename T>
   std::vector<T> Sorted(std::vector<T> a) {
     std::sort(a.begin(), a.end());
     return a;
   }
+
+  template<typename T>
+  std::vector<uint32_t> StableArgSorted(const std::vector<T>& a) {
+    auto indices = Iota<uint32_t>(a.size(), 0);
+    std::stable_sort(indices.begin(), indices.end(),
+                     [&](uint32_t i, uint32_t j) { return a[i] < a[j]; });
+    return indices;
+  }
 };
 
 TEST_F(SortTests, SingleBlockContiguous) {
@@ -103,3 +180,249 @@ TEST_F(SortTests, ArgSortSingleBlockContiguous) {
               (std::vector<uint32_t>{3, 2, 0, 1, 3, 2, 1, 0}));
   }
 }
+
+TEST_F(SortTests, ArgSortSingleBlockMerges) {
+  auto a = RandomNumbers<float>(1000, 100);
+  EXPECT_EQ(RunArgSort<float>(0, betann::SortInputType::Contiguous,
+                              a, {1000}, {1}),
+            StableArgSorted(a));
+}
+
+TEST_F(SortTests, MultiBlockContiguous) {
+  for (uint32_t size : {2049, 5000, 9000, 30000}) {
+    SCOPED_TRACE(fmt::format("size: {}", size));
+    auto a = RandomNumbers<uint32_t>(size);
+    EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Values>(
+                  0, betann::SortInputType::Contiguous, a, {size}, {1}),
+              Sorted(a));
+    auto b = RandomNumbers<float>(size);
+    EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Indices>(
+                  0, betann::SortInputType::Contiguous, b, {size}, {1}),
+              StableArgSorted(b));
+  }
+}
+
+TEST_F(SortTests, MultiBlockGeneral) {
+  uint32_t size = 4500;
+  auto a = RandomNumbers<int32_t>(size);
+  auto b = RandomNumbers<int32_t>(size);
+  auto c = Concat(a, b);
+  for (auto type : {betann::SortInputType::Contiguous,
+                    betann::SortInputType::General}) {
+    EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Values>(
+                  1, type, c, {2, size}, {size, 1}),
+              Concat(Sorted(a), Sorted(b)));
+    EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Indices>(
+                  1, type, c, {2, size}, {size, 1}),
+              Concat(StableArgSorted(a), StableArgSorted(b)));
+  }
+  // Sort the strided axis of interleaved rows.
+  std::vector<int32_t> interleaved;
+  for (uint32_t i = 0; i < size; ++i) {
+    interleaved.push_back(a[i]);
+    interleaved.push_back(b[i]);
+  }
+  auto sortedA = Sorted(a);
+  auto sortedB = Sorted(b);
+  std::vector<int32_t> expected;
+  for (uint32_t i = 0; i < size; ++i) {
+    expected.push_back(sortedA[i]);
+    expected.push_back(sortedB[i]);
+  }
+  EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Values>(
+                0, betann::SortInputType::General,
+                interleaved, {size, 2}, {2, 1}),
+            expected);
+}
+
+TEST_F(SortTests, RadixSort) {
+  uint32_t size = 40000;
+  auto a = RandomNumbers<uint32_t>(size, 1 << 30, 0);
+  EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Values>(
+                0, betann::SortInputType::Contiguous, a, {size}, {1}),
+            Sorted(a));
+  auto b = RandomNumbers<int32_t>(size, 1000, -1000);
+  EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Values>(
+                0, betann::SortInputType::Contiguous, b, {size}, {1}),
+            Sorted(b));
+  EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Indices>(
+                0, betann::SortInputType::Contiguous, b, {size}, {1}),
+            StableArgSorted(b));
+  auto c = RandomNumbers<float>(size, 1000, -1000);
+  for (float& f : c)
+    f /= 7;
+  EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Values>(
+                0, betann::SortInputType::Contiguous, c, {size}, {1}),
+            Sorted(c));
+  EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Indices>(
+                0, betann::SortInputType::Contiguous, c, {size}, {1}),
+            StableArgSorted(c));
+  if (device_.SupportsF16()) {
+    std::vector<uint16_t> halfs(size);
+    std::vector<float> rounded(size);
+    for (uint32_t i = 0; i < size; ++i) {
+      halfs[i] = betann::Float32ToFloat16(c[i]);
+      rounded[i] = betann::Float16ToFloat32(halfs[i]);
+    }
+    auto indices = StableArgSorted(rounded);
+    std::vector<uint16_t> expected;
+    for (uint32_t i : indices)
+      expected.push_back(halfs[i]);
+    EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Values>(
+                  0, betann::SortInputType::Contiguous, halfs, {size}, {1}),
+              expected);
+    EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Indices>(
+                  0, betann::SortInputType::Contiguous, halfs, {size}, {1}),
+              indices);
+  }
+}
+
+TEST_F(SortTests, RadixSortRows) {
+  uint32_t size = 33000;
+  auto a = RandomNumbers<float>(size, 100, -100);
+  auto b = RandomNumbers<float>(size, 100, -100);
+  auto c = RandomNumbers<float>(size, 100, -100);
+  auto input = Concat(a, b, c);
+  EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Values>(
+                1, betann::SortInputType::Contiguous,
+                input, {3, size}, {size, 1}),
+            Concat(Sorted(a), Sorted(b), Sorted(c)));
+  EXPECT_EQ(RunMultiBlockSort<betann::SortResultType::Indices>(
+                1, betann::SortInputType::Contiguous,
+                input, {3, size}, {size, 1}),
+            Concat(StableArgSorted(a), StableArgSorted(b),
+                   StableArgSorted(c)));
+}
+
+TEST_F(SortTests, TopK) {
+  uint32_t size = 3000;
+  for (uint32_t k : {1, 5, 17, 32, 33, 100, 3000}) {
+    SCOPED_TRACE(fmt::format("k: {}", k));
+    // Use distinct values so the top k indices are certain.
+    auto a = Iota<int32_t>(size, -1500);
+    std::shuffle(a.begin(), a.end(), std::mt19937(k));
+    auto sortedIndices = StableArgSorted(a);
+    std::vector<uint32_t> expectedIndices(sortedIndices.end() - k,
+                                          sortedIndices.end());
+    std::sort(expectedIndices.begin(), expectedIndices.end());
+    auto [values, indices] = RunTopK<int32_t>(0, k, a, {size}, {1});
+    for (uint32_t i = 0; i < k; ++i)
+      EXPECT_EQ(values[i], a[indices[i]]);
+    EXPECT_EQ(indices, expectedIndices);
+  }
+}
+
+TEST_F(SortTests, TopKTies) {
+  uint32_t size = 3000;
+  // Many duplicates of the k-th largest value, of which the ones with the
+  // lowest indices are picked.
+  auto a = RandomNumbers<int32_t>(size, 20, 0);
+  auto order = Iota<uint32_t>(size, 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](uint32_t i, uint32_t j) { return a[i] > a[j]; });
+  for (uint32_t k : {5, 32, 33, 100, 1000}) {
+    SCOPED_TRACE(fmt::format("k: {}", k));
+    std::vector<uint32_t> expectedIndices(order.begin(), order.begin() + k);
+    std::sort(expectedIndices.begin(), expectedIndices.end());
+    auto [values, indices] = RunTopK<int32_t>(0, k, a, {size}, {1});
+    for (uint32_t i = 0; i < k; ++i)
+      EXPECT_EQ(values[i], a[indices[i]]);
+    EXPECT_EQ(indices, expectedIndices);
+  }
+}
+
+TEST_F(SortTests, TopKOrder) {
+  uint32_t size = 500;
+  auto a = RandomNumbers<float>(size, 100, -100);
+  a[7] = std::numeric_limits<float>::quiet_NaN();
+  a[100] = -std::numeric_limits<float>::quiet_NaN();
+  a[42] = std::numeric_limits<float>::infinity();
+  a[300] = -std::numeric_limits<float>::infinity();
+  a[13] = -0.0f;
+  a[450] = 0.0f;
+  // Floats are ranked by their bits, like the keys of radix sort.
+  auto key = [](float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return (bits & 0x80000000) ? ~bits : bits | 0x80000000;
+  };
+  auto order = Iota<uint32_t>(size, 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t i, uint32_t j) {
+    return key(a[i]) > key(a[j]);
+  });
+  // Both sides of the k that switches from topk_insert to topk_select write
+  // the results in the order of indices.
+  for (uint32_t k : {8, 32, 33, 250}) {
+    SCOPED_TRACE(fmt::format("k: {}", k));
+    std::vector<uint32_t> expectedIndices(order.begin(), order.begin() + k);
+    std::sort(expectedIndices.begin(), expectedIndices.end());
+    auto [values, indices] = RunTopK<float>(0, k, a, {size}, {1});
+    EXPECT_EQ(indices, expectedIndices);
+    for (uint32_t i = 0; i < k; ++i) {
+      float expected = a[expectedIndices[i]];
+      if (std::isnan(expected))
+        EXPECT_TRUE(std::isnan(values[i]));
+      else
+        EXPECT_EQ(values[i], expected);
+    }
+  }
+}
+
+TEST_F(SortTests, TopKRows) {
+  uint32_t size = 1000;
+  auto a = RandomNumbers<float>(size * 3, 100000, -100000);
+  for (uint32_t k : {8, 200}) {
+    SCOPED_TRACE(fmt::format("k: {}", k));
+    // Rows are contiguous.
+    auto [values, indices] = RunTopK<float>(1, k, a, {3, size}, {size, 1});
+    for (uint32_t r = 0; r < 3; ++r) {
+      std::vector<float> row(a.begin() + r * size, a.begin() + (r + 1) * size);
+      auto expected = Sorted(row);
+      expected.erase(expected.begin(), expected.end() - k);
+      std::vector<float> got(values.begin() + r * k,
+                             values.begin() + (r + 1) * k);
+      EXPECT_EQ(Sorted(got), expected);
+      for (uint32_t i = 0; i < k; ++i)
+        EXPECT_EQ(got[i], row[indices[r * k + i]]);
+    }
+    // Rows are strided.
+    auto [valuesT, indicesT] = RunTopK<float>(0, k, a, {size, 3}, {3, 1});
+    for (uint32_t r = 0; r < 3; ++r) {
+      std::vector<float> row;
+      for (uint32_t i = 0; i < size; ++i)
+        row.push_back(a[i * 3 + r]);
+      auto expected = Sorted(row);
+      expected.erase(expected.begin(), expected.end() - k);
+      std::vector<float> got;
+      for (uint32_t i = 0; i < k; ++i) {
+        got.push_back(valuesT[i * 3 + r]);
+        EXPECT_EQ(valuesT[i * 3 + r], row[indicesT[i * 3 + r]]);
+      }
+      EXPECT_EQ(Sorted(got), expected);
+    }
+  }
+}
+
+TEST_F(SortTests, SingleBlockShortRows) {
+  for (uint32_t size : {1, 7, 32, 33, 100, 300, 1000}) {
+    for (uint32_t rows : {1, 3, 65, 130}) {
+      SCOPED_TRACE(fmt::format("size: {}, rows: {}", size, rows));
+      std::vector<float> input;
+      std::vector<float> expected;
+      std::vector<uint32_t> expectedIndices;
+      for (uint32_t r = 0; r < rows; ++r) {
+        auto row = RandomNumbers<float>(size, 50);
+        input = Concat(input, row);
+        expected = Concat(expected, Sorted(row));
+        expectedIndices = Concat(expectedIndices, StableArgSorted(row));
+      }
+      for (auto type : {betann::SortInputType::Contiguous,
+                        betann::SortInputType::General}) {
+        EXPECT_EQ(RunSort<float>(1, type, input, {rows, size}, {size, 1}),
+                  expected);
+        EXPECT_EQ(RunArgSort<float>(1, type, input, {rows, size}, {size, 1}),
+                  expectedIndices);
+      }
+    }
+  }
+}
@@ -0,0 +1,46 @@
+#include "betann_tests.h"
+
+#include "betann/upload_ring.h"
+
+class UploadRingTests : public BetaNNTests {};
+
+TEST_F(UploadRingTests, Upload) {
+  // Use small chunks so the ring wraps around many times.
+  betann::UploadRing ring(device_, 256, 2);
+  auto a = RandomNumbers<uint32_t>(10000);
+  betann::Buffer out = CreateOutput<uint32_t>(10004);
+  device_.WaitFor(ring.Upload(a.data(), a.size() * sizeof(uint32_t),
+                              out, 4 * sizeof(uint32_t)));
+  auto result = ReadFromBuffer<uint32_t>(out, 10004);
+  EXPECT_EQ(std::vector<uint32_t>(result.begin() + 4, result.end()), a);
+  EXPECT_THROW(ring.Upload(a.data(), 3, out), std::runtime_error);
+}
+
+TEST_F(UploadRingTests, MultipleThreads) {
+  betann::UploadRing ring(device_, 4 * 1024 * 1024, 4, 4);
+  auto a = RandomNumbers<float>(3 * 1024 * 1024);
+  betann::Buffer out = CreateOutput<float>(a.size());
+  ring.Upload(a.data(), a.size() * sizeof(float), out);
+  ring.WaitAll();
+  EXPECT_EQ(ReadFromBuffer<float>(out, a.size()), a);
+}
+
+TEST_F(UploadRingTests, CreateBufferFromData) {
+  betann::UploadRing ring(device_, 16, 2);
+  std::vector<uint8_t> a = RandomNumbers<uint8_t>(37, 255, 0);
+  betann::Buffer buffer = ring.CreateBufferFromData(
+      a.data(), a.size(), betann::BufferUsage::Storage |
+                          betann::BufferUsage::CopySrc);
+  EXPECT_EQ(buffer.GetSize(), 40);
+  EXPECT_EQ(ReadFromBuffer<uint8_t>(buffer, 37), a);
+}
+
+TEST_F(UploadRingTests, UploadWhileCapturing) {
+  betann::UploadRing ring(device_, 256, 2);
+  auto a = RandomNumbers<uint32_t>(64);
+  betann::Buffer out = CreateOutput<uint32_t>(a.size());
+  device_.BeginCapture();
+  EXPECT_THROW(ring.Upload(a.data(), a.size() * sizeof(uint32_t), out),
+               std::runtime_error);
+  device_.EndCapture();
+}